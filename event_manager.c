@@ -29,19 +29,20 @@ static bool equalEvent(PQElement event1, PQElement event2)
     return eventEqual((Event)event1, (Event)event2);
 }
 
-static PQElementPriority copyDate(PQElementPriority date)
+static unsigned long hashEvent(PQElement event)
 {
-    return (PQElementPriority)dateCopy((Date)date);
+    return (unsigned long)eventGetId((Event)event);
 }
 
-static void freeDate(PQElementPriority date)
-{
-    dateDestroy((Date)date);
-}
-
-static int compareDate(PQElementPriority date1, PQElementPriority date2)
+/**
+ *   The priority of an event is an inline key of its date, ordered like dateCompare.
+ *   The queue is created with lowest_first, so earlier dates come first
+ */
+static int64_t dateKey(Date date)
 {
-    return -dateCompare((Date)date1, (Date)date2);
+    int day = 0, month = 0, year = 0;
+    dateGet(date, &day, &month, &year);
+    return ((int64_t)year * 12 + month) * 31 + day;
 }
 
 
@@ -52,6 +53,38 @@ struct EventManager_t{
     MemberList member_list;
 };
 
+/**
+ *   Functions for removing the events which have passed with pqPopWhile - the context is the event manager
+ */
+static bool eventHasPassed(PQElement event, PQElementPriority date, void* em)
+{
+    (void)date;
+    return dateCompare(((EventManager)em)->init_date, eventGetDate((Event)event)) > 0;
+}
+
+static void passEvent(PQElement event, PQElementPriority date, void* em)
+{
+    (void)date;
+    memberListUpdatePassedEvent(((EventManager)em)->member_list, eventGetMemberList((Event)event));
+}
+
+/**
+ *   Function for looking events up by id in the id index of the event queue - the context is the id
+ */
+static bool isEventWithId(PQElement event, void* event_id)
+{
+    return eventGetId((Event)event) == *(int*)event_id;
+}
+
+/**
+ *   Finds the handle of the event with the given id through the id index of the event queue, so the internal
+ *   iterator of the event queue is left alone. Returns PQ_ELEMENT_DOES_NOT_EXISTS if there is no such event
+ */
+static PriorityQueueResult findEvent(EventManager em, int event_id, PQHandle* handle)
+{
+    return pqGetHandleByHash(em->event_list, (unsigned long)event_id, isEventWithId, &event_id, handle);
+}
+
 EventManager createEventManager(Date date)
 {
     if(!date)
@@ -63,7 +96,18 @@ EventManager createEventManager(Date date)
     {
         return NULL;
     }
-    PriorityQueue pq = pqCreate(copyEvent, freeEvent, equalEvent, copyDate, freeDate, compareDate);
+    // Events are removed by id from anywhere in the queue, so their nodes are only marked dead and compacted later
+    PQOptions options = {
+        .copy_element = copyEvent,
+        .free_element = freeEvent,
+        .equal_elements = equalEvent,
+        .hash_element = hashEvent,
+        .key_type = PQ_KEY_INT64,
+        .lowest_first = true,
+        .backend = PQ_BACKEND_CALENDAR,
+        .lazy_removal = true
+    };
+    PriorityQueue pq = pqCreateEx(&options);
     if(!pq)
     {
         free(em);
@@ -122,47 +166,33 @@ EventManagerResult emAddEventByDate(EventManager em, char* event_name, Date date
     {
         return EM_OUT_OF_MEMORY;
     }
-    Date new_date = dateCopy(date);
-    {
-        if(!date)
-        {
-            eventDestroy(new_event);
-            return EM_OUT_OF_MEMORY;
-        }
-    }
+    int64_t new_date = dateKey(date);
     PQ_FOREACH(Event, iter, em->event_list)
     {
         if(eventCompare(iter, new_event))
         {
             eventDestroy(new_event);
-            dateDestroy(new_date);
             return EM_EVENT_ALREADY_EXISTS;
         }
         else if(eventEqual(iter, new_event))
         {
             eventDestroy(new_event);
-            dateDestroy(new_date);
             return EM_EVENT_ID_ALREADY_EXISTS;
         }
     }
-    PriorityQueueResult result = pqInsert(em->event_list, (PQElement)new_event, (PQElementPriority)new_date);
+    PriorityQueueResult result = pqInsertOwned(em->event_list, (PQElement)new_event, (PQElementPriority)&new_date);
     switch (result)
     {
     case PQ_NULL_ARGUMENT:
             eventDestroy(new_event);
-            dateDestroy(new_date);
             return EM_NULL_ARGUMENT;
     case PQ_OUT_OF_MEMORY:
             eventDestroy(new_event);
-            dateDestroy(new_date);
             return EM_OUT_OF_MEMORY;
     case PQ_SUCCESS:
-            eventDestroy(new_event);
-            dateDestroy(new_date);
             return EM_SUCCESS;
     default:
             eventDestroy(new_event);
-            dateDestroy(new_date);
             return EM_ERROR;
     }
     return EM_ERROR;
@@ -202,17 +232,18 @@ EventManagerResult emRemoveEvent(EventManager em, int event_id)
     {
         return EM_INVALID_EVENT_ID;
     }
-    Event temp_event = NULL;
-    PQ_FOREACH(Event, iter, em->event_list)
+    PQHandle handle = NULL;
+    PriorityQueueResult found = findEvent(em, event_id, &handle);
+    if(found != PQ_SUCCESS)
     {
-        if(eventGetId(iter) == event_id)
-        {
-            temp_event = iter;
-            break;
-        }
+        return found == PQ_OUT_OF_MEMORY ? EM_OUT_OF_MEMORY : EM_EVENT_NOT_EXISTS;
     }
-    memberListUpdatePassedEvent(em->member_list, eventGetMemberList(temp_event));
-    PriorityQueueResult result = pqRemoveElement(em->event_list, (PQElement)temp_event);
+    Event temp_event = (Event)pqGetElementByHandle(em->event_list, handle);
+    if(!memberListUpdatePassedEvent(em->member_list, eventGetMemberList(temp_event)))
+    {
+        return EM_OUT_OF_MEMORY;
+    }
+    PriorityQueueResult result = pqRemoveByHandle(em->event_list, handle);
     switch(result)
     {
     case PQ_NULL_ARGUMENT:
@@ -241,56 +272,38 @@ EventManagerResult emChangeEventDate(EventManager em, int event_id, Date new_dat
     {
         return EM_INVALID_EVENT_ID;
     }
-    Event temp_event = NULL;
-    PQ_FOREACH(Event, iter, em->event_list)
+    PQHandle handle = NULL;
+    PriorityQueueResult found = findEvent(em, event_id, &handle);
+    if(found != PQ_SUCCESS)
     {
-        if(eventGetId(iter) == event_id)
-        {
-            temp_event = iter;
-            break;
-        }
-    }
-    if(!temp_event)
-    {
-        return EM_EVENT_ID_NOT_EXISTS;
-    }
-    temp_event = eventCopy(temp_event);
-    if(!temp_event)
-    {
-        return EM_OUT_OF_MEMORY;
+        return found == PQ_OUT_OF_MEMORY ? EM_OUT_OF_MEMORY : EM_EVENT_ID_NOT_EXISTS;
     }
+    Event temp_event = (Event)pqGetElementByHandle(em->event_list, handle);
     Event iterate_event = eventCreate(eventGetName(temp_event), eventGetId(temp_event), new_date);
-    if(!iterate_event)
+    PQIterator iterator = pqIterBegin(em->event_list);
+    if(!iterate_event || !iterator)
     {
-        eventDestroy(temp_event);
+        eventDestroy(iterate_event);
+        pqIterEnd(iterator);
         return EM_OUT_OF_MEMORY;
     }
-    PQ_FOREACH(Event, iter, em->event_list)
+    for(Event iter = pqIterNext(iterator); iter; iter = pqIterNext(iterator))
     {
         if(eventCompare(iter, iterate_event))
         {
-            eventDestroy(temp_event);
             eventDestroy(iterate_event);
+            pqIterEnd(iterator);
             return EM_EVENT_ALREADY_EXISTS;
         }
     }
-    PriorityQueueResult result = pqChangePriority(  em->event_list, 
-                                                    (PQElement)temp_event, 
-                                                    (PQElementPriority)eventGetDate(temp_event), 
-                                                    (PQElementPriority)new_date);
+    eventDestroy(iterate_event);
+    pqIterEnd(iterator);
+    int64_t new_key = dateKey(new_date);
+    PriorityQueueResult result = pqChangePriorityByHandle(em->event_list, handle, (PQElementPriority)&new_key);
     if(result == PQ_SUCCESS)
     {
-        PQ_FOREACH(Event, iter, em->event_list)
-        {
-            if(eventEqual(iter, iterate_event))
-            {
-                eventChangeDate(iter, new_date);
-                break;
-            }
-        }
-    }    
-    eventDestroy(iterate_event); 
-    eventDestroy(temp_event);                                     
+        eventChangeDate(temp_event, new_date);
+    }
     switch(result)
     {
     case PQ_NULL_ARGUMENT:
@@ -349,20 +362,15 @@ EventManagerResult emAddMemberToEvent(EventManager em, int member_id, int event_
     {
         return EM_INVALID_EVENT_ID;
     }
-    Event event_ptr = NULL;
-    PQ_FOREACH(Event, iter, em->event_list)
-    {
-        if(eventGetId(iter) == event_id)
-        {
-            event_ptr = iter;
-            break;
-        }
-    }
-    if(!event_ptr)
+    PQHandle handle = NULL;
+    PriorityQueueResult found = findEvent(em, event_id, &handle);
+    if(found != PQ_SUCCESS)
     {
-        return EM_EVENT_ID_NOT_EXISTS;
+        return found == PQ_OUT_OF_MEMORY ? EM_OUT_OF_MEMORY : EM_EVENT_ID_NOT_EXISTS;
     }
-    if(!memberListContain(em->member_list, member_id))
+    Event event_ptr = (Event)pqGetElementByHandle(em->event_list, handle);
+    Member temp_member = getMember(em->member_list, member_id);
+    if(!temp_member)
     {
         return EM_MEMBER_ID_NOT_EXISTS;
     }
@@ -370,25 +378,24 @@ EventManagerResult emAddMemberToEvent(EventManager em, int member_id, int event_
     {
         return EM_EVENT_AND_MEMBER_ALREADY_LINKED;
     }
-    Member temp_member = getMember(em->member_list, member_id);
-    if(!temp_member)
-    {
-        return EM_OUT_OF_MEMORY;
-    }
     char* temp_name = memberGetName(temp_member);
     Member new_member = memberCreate(temp_name, member_id);
     if(!new_member)
     {
         return EM_OUT_OF_MEMORY;
     }
-    if(memberListInsert(eventGetMemberList(event_ptr), new_member))
+    if(!memberListInsert(eventGetMemberList(event_ptr), new_member))
     {
-        memberListAddToEventNum(em->member_list, member_id, 1);
         memberDestroy(new_member);
-        return EM_SUCCESS;
+        return EM_OUT_OF_MEMORY;
     }
     memberDestroy(new_member);
-    return EM_OUT_OF_MEMORY;
+    if(!memberListAddToEventNum(em->member_list, member_id, 1))
+    {
+        memberListRemove(eventGetMemberList(event_ptr), member_id);
+        return EM_OUT_OF_MEMORY;
+    }
+    return EM_SUCCESS;
 }
 
 
@@ -406,19 +413,13 @@ EventManagerResult emRemoveMemberFromEvent(EventManager em, int member_id, int e
     {
         return EM_INVALID_EVENT_ID;
     }
-    Event event_ptr = NULL;
-    PQ_FOREACH(Event, iter, em->event_list)
+    PQHandle handle = NULL;
+    PriorityQueueResult found = findEvent(em, event_id, &handle);
+    if(found != PQ_SUCCESS)
     {
-        if(eventGetId(iter) == event_id)
-        {
-            event_ptr = iter;
-            break;
-        }
-    }
-    if(!event_ptr)
-    {
-        return EM_EVENT_ID_NOT_EXISTS;
+        return found == PQ_OUT_OF_MEMORY ? EM_OUT_OF_MEMORY : EM_EVENT_ID_NOT_EXISTS;
     }
+    Event event_ptr = (Event)pqGetElementByHandle(em->event_list, handle);
     if(!memberListContain(em->member_list, member_id))
     {
         return EM_MEMBER_ID_NOT_EXISTS;
@@ -427,8 +428,15 @@ EventManagerResult emRemoveMemberFromEvent(EventManager em, int member_id, int e
     {
         return EM_EVENT_AND_MEMBER_NOT_LINKED;
     }
-    memberListRemove(eventGetMemberList(event_ptr), member_id);
-    memberListAddToEventNum(em->member_list, member_id, -1);
+    if(!memberListAddToEventNum(em->member_list, member_id, -1))
+    {
+        return EM_OUT_OF_MEMORY;
+    }
+    if(!memberListRemove(eventGetMemberList(event_ptr), member_id))
+    {
+        memberListAddToEventNum(em->member_list, member_id, 1);
+        return EM_OUT_OF_MEMORY;
+    }
     return EM_SUCCESS;
 }
 
@@ -447,20 +455,9 @@ EventManagerResult emTick(EventManager em, int days)
     {
         dateTick(em->init_date);
     }
-    int events_to_remove = 0;
-    PQ_FOREACH(Event, iter, em->event_list)
+    if(pqPopWhile(em->event_list, eventHasPassed, em, passEvent) != PQ_SUCCESS)
     {
-        if(dateCompare(em->init_date, eventGetDate(iter)) > 0)
-        {
-            events_to_remove++;
-        }
-    }
-    for(int i=0; i<events_to_remove; i++)
-    {
-            Event first_to_remove = (Event)pqGetFirst(em->event_list);
-            MemberList member_list = eventGetMemberList(first_to_remove);
-            memberListUpdatePassedEvent(em->member_list, member_list);
-            pqRemoveElement(em->event_list, (PQElement)first_to_remove);
+        return EM_OUT_OF_MEMORY;
     }
     return EM_SUCCESS;
 }
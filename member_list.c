@@ -1,12 +1,6 @@
 #include "member_list.h"
 #include "priority_queue.h"
 
-/** Struct representing the Member list */
-typedef struct MemberPriority_t{
-    int member_id;
-    int num_event;
-} *MemberPriority;
-
 /**
  *   Functions for operating on Member elements & Int priorety element
  *   in the generic ADT priorety queue
@@ -26,45 +20,18 @@ static bool equalMember(PQElement member1, PQElement member2)
     return memberEqual((Member)member1, (Member)member2);
 }
 
-static PQElementPriority copyInfo(PQElementPriority member_priority)
-{
-    if (!member_priority) 
-    {
-        return NULL;
-    }
-    MemberPriority temp = (MemberPriority)member_priority;
-    MemberPriority copy = malloc(sizeof(*copy));
-    if (!copy)
-    {
-        return NULL;
-    }
-    copy->member_id = temp->member_id;
-    copy->num_event = temp->num_event;
-    return (PQElementPriority)copy;
-}
-
-static void freeInfo(PQElementPriority member_priority)
+static unsigned long hashMember(PQElement member)
 {
-    if(!member_priority)
-    {
-        return;
-    }
-    free(member_priority);
+    return (unsigned long)memberGetId((Member)member);
 }
 
-static int compareInfo(PQElementPriority member_info1, PQElementPriority member_info2)
+/**
+ *   The priority of a member is an inline key - members with more events come first,
+ *   and between members with the same number of events the lower id comes first
+ */
+static int64_t memberKey(int member_id, int num_event)
 {
-    if(!member_info1 || !member_info2) 
-    {                                           
-        return 0;
-    }
-    MemberPriority member_priority1 = (MemberPriority)member_info1;
-    MemberPriority member_priority2 = (MemberPriority)member_info2;
-    if(member_priority1->num_event == member_priority2->num_event)
-    {
-        return (member_priority2->member_id - member_priority1->member_id);
-    }
-    return (member_priority1->num_event - member_priority2->num_event);
+    return (int64_t)num_event * ((int64_t)1 << 32) - member_id;
 }
 
 
@@ -73,6 +40,33 @@ struct MemberList_t{
     PriorityQueue member_queue;
 };
 
+/**
+ *   Function for looking members up by id in the id index of the member queue - the context is the id
+ */
+static bool isMemberWithId(PQElement member, void* member_id)
+{
+    return memberGetId((Member)member) == *(int*)member_id;
+}
+
+/**
+ *   Finds the member with the given id through the id index of the member queue, without changing the queue.
+ *   Returns NULL if there is no such member
+ */
+static Member findMember(MemberList member_list, int member_id)
+{
+    return (Member)pqFindByHash(member_list->member_queue, (unsigned long)member_id, isMemberWithId, &member_id);
+}
+
+/**
+ *   Finds the handle of the member with the given id, like findMember. The member queue stops sharing its
+ *   members with its copies first, so the handle can be changed. Returns PQ_ELEMENT_DOES_NOT_EXISTS if there
+ *   is no such member, and PQ_OUT_OF_MEMORY if copying the shared members failed
+ */
+static PriorityQueueResult findMemberHandle(MemberList member_list, int member_id, PQHandle* handle)
+{
+    return pqGetHandleByHash(member_list->member_queue, (unsigned long)member_id, isMemberWithId, &member_id, handle);
+}
+
 
 MemberList memberListCreate()
 {
@@ -81,7 +75,17 @@ MemberList memberListCreate()
     {
         return NULL;
     }
-    PriorityQueue member_queue = pqCreate(copyMember, freeMember, equalMember, copyInfo, freeInfo, compareInfo);
+    // Member lists are small and printed often, so they are kept sorted instead of in a heap
+    PQOptions options = {
+        .copy_element = copyMember,
+        .free_element = freeMember,
+        .equal_elements = equalMember,
+        .hash_element = hashMember,
+        .key_type = PQ_KEY_INT64,
+        .backend = PQ_BACKEND_SORTED_ARRAY,
+        .copy_on_write = true
+    };
+    PriorityQueue member_queue = pqCreateEx(&options);
     if(!member_queue)
     {
         free(member_list);
@@ -141,20 +145,11 @@ bool memberListInsert(MemberList member_list, Member to_add)
     {
         return false;
     }
-    MemberPriority member_priority = malloc(sizeof(*member_priority));
-    if(!member_priority)
-    {
-        return false;
-    } 
-    member_priority->member_id = memberGetId(to_add);
-    member_priority->num_event = 0;
-    if(pqInsert(member_list->member_queue, (PQElement)new_member, (PQElementPriority)member_priority) == PQ_SUCCESS)
+    int64_t member_priority = memberKey(memberGetId(to_add), 0);
+    if(pqInsertOwned(member_list->member_queue, (PQElement)new_member, (PQElementPriority)&member_priority) == PQ_SUCCESS)
     {
-        free(member_priority);
-        memberDestroy(new_member);
         return true;
     }
-    free(member_priority);
     memberDestroy(new_member);
     return false;
 }
@@ -166,31 +161,23 @@ bool memberListContain(MemberList member_list, int id)
     {
         return false;
     }
-    PQ_FOREACH(Member, iter, member_list->member_queue)
-    {
-        if(memberGetId(iter) == id)
-        {
-            return true;
-        }
-    }
-    return false;
+    return findMember(member_list, id) != NULL;
 }
 
 
-void memberListRemove(MemberList member_list, int id)
+bool memberListRemove(MemberList member_list, int id)
 {
     if(!member_list)
     {
-        return;
+        return false;
     }
-    PQ_FOREACH(Member, iter, member_list->member_queue)
+    PQHandle handle = NULL;
+    PriorityQueueResult result = findMemberHandle(member_list, id, &handle);
+    if(result == PQ_ELEMENT_DOES_NOT_EXISTS)
     {
-        if(memberGetId(iter) == id && pqRemoveElement(member_list->member_queue, (PQElement)iter) == PQ_SUCCESS)
-        {
-            return;
-        }
+        return true;
     }
-    return;
+    return result == PQ_SUCCESS && pqRemoveByHandle(member_list->member_queue, handle) == PQ_SUCCESS;
 }
 
 
@@ -200,68 +187,45 @@ const Member getMember(MemberList member_list, int member_id)
     {
         return NULL;
     }
-    PQ_FOREACH(Member, iter, member_list->member_queue)
-    {
-        if(memberGetId(iter) == member_id)
-        {
-            return iter;
-        }
-    }
-    return NULL;
+    return findMember(member_list, member_id);
 }
 
-void memberListAddToEventNum(MemberList member_list, int member_id, int n)
+bool memberListAddToEventNum(MemberList member_list, int member_id, int n)
 {
     if(!member_list)
     {
-        return;
+        return false;
     }
-    Member temp_member = memberCopy(getMember(member_list, member_id));
-    if(!temp_member)
+    PQHandle handle = NULL;
+    PriorityQueueResult result = findMemberHandle(member_list, member_id, &handle);
+    if(result != PQ_SUCCESS)
     {
-        return;
+        return result == PQ_ELEMENT_DOES_NOT_EXISTS;
     }
-    int old_num = memberGetEventNum(getMember(member_list, member_id));
-    int new_num = memberGetEventNum(getMember(member_list, member_id)) + n;
-    MemberPriority member_priority_new = malloc(sizeof(*member_priority_new));
-    if(!member_priority_new)
+    Member member = (Member)pqGetElementByHandle(member_list->member_queue, handle);
+    int new_num = memberGetEventNum(member) + n;
+    int64_t member_priority_new = memberKey(member_id, new_num);
+    if(pqChangePriorityByHandle(member_list->member_queue, handle, (PQElementPriority)&member_priority_new) != PQ_SUCCESS)
     {
-        memberDestroy(temp_member);
-        return;
-    }    
-    MemberPriority member_priority_old = malloc(sizeof(*member_priority_old));
-    if(!member_priority_old)
-    {
-        memberDestroy(temp_member);
-        free(member_priority_new);
-        return;
+        return false;
     }
-    member_priority_new->member_id = member_id;
-    member_priority_new->num_event = new_num;
-    member_priority_old->member_id = member_id;
-    member_priority_old->num_event = old_num;
-    pqChangePriority(   member_list->member_queue, 
-                        (PQElement)temp_member, 
-                        (PQElementPriority)member_priority_old,
-                        (PQElementPriority)member_priority_new);
-    memberSetNumEvent(getMember(member_list, member_id), new_num);
-    memberDestroy(temp_member);
-    free(member_priority_new);
-    free(member_priority_old);
-    return;
+    memberSetNumEvent(member, new_num);
+    return true;
 }
 
 
-void memberListUpdatePassedEvent(MemberList member_list1, MemberList member_list2)
+bool memberListUpdatePassedEvent(MemberList member_list1, MemberList member_list2)
 {
     if(!member_list1 || !member_list2)
     {
-        return;
+        return false;
     }
+    bool result = true;
     PQ_FOREACH(Member, iter, member_list2->member_queue)
     {
-        memberListAddToEventNum(member_list1, memberGetId(iter), -1);
+        result = memberListAddToEventNum(member_list1, memberGetId(iter), -1) && result;
     }
+    return result;
 }
 
 void printMemberList(MemberList member_list, FILE* fd)
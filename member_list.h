@@ -73,9 +73,11 @@ bool memberListContain(MemberList member_list, int id);
 *
 * @param member_list - Target member list.
 * @param id - the id to of the member to remove.
-*
+* @return
+* 	false if a NULL was sent or an allocation failed, and the member was not removed.
+* 	Otherwise true.
 */
-void memberListRemove(MemberList member_list, int id);
+bool memberListRemove(MemberList member_list, int id);
 
 
 /**
@@ -98,8 +100,11 @@ const Member getMember(MemberList member_list, int member_id);
 * @param member_list - Target member list.
 * @param member_id - the id to of the member to remove.
 * @param n - Target member list.
+* @return
+* 	false if a NULL was sent or an allocation failed, and the amount was not changed.
+* 	Otherwise true, also if there is no member with the id.
 */
-void memberListAddToEventNum(MemberList member_list, int member_id, int n);
+bool memberListAddToEventNum(MemberList member_list, int member_id, int n);
 
 
 /**
@@ -108,8 +113,11 @@ void memberListAddToEventNum(MemberList member_list, int member_id, int n);
 *
 * @param member_list1 - Target member list to update.
 * @param member_list2 - Reference list of members that will be updated.
+* @return
+* 	false if a NULL was sent or an allocation failed, and some of the members were not updated.
+* 	Otherwise true.
 */
-void memberListUpdatePassedEvent(MemberList member_list1, MemberList member_list2);
+bool memberListUpdatePassedEvent(MemberList member_list1, MemberList member_list2);
 
 
 /**
@@ -0,0 +1,220 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "multi_queue.h"
+
+/** Constants for the random numbers - xorshift64* */
+#define RANDOM_MULTIPLIER 0x2545F4914F6CDD1DULL
+#define RANDOM_SEED_MIXER 0x9E3779B97F4A7C15ULL
+
+/**
+* Struct representing the random state of a thread using a multi queue.
+* The states are also linked in the multi queue, so mqDestroy can free the states of threads which did not exit.
+*/
+typedef struct RandomState_t {
+    uint64_t value;
+    MultiQueue multi_queue;
+    struct RandomState_t* previous;
+    struct RandomState_t* next;
+} *RandomState;
+
+/**
+* Struct representing a multi queue.
+* Every thread keeps its own random state under random_key, so choosing a queue takes no lock.
+* states_lock is only taken when a thread creates its state, and when it exits.
+*/
+struct MultiQueue_t {
+    PriorityQueue* queues;
+    int queue_count;
+    pthread_key_t random_key;
+    pthread_mutex_t states_lock;
+    RandomState states;
+};
+
+/**
+* randomNext: Advances a xorshift64* random state.
+*
+* @param state - The random state, which is never 0.
+* @return
+* 	The next random number.
+*/
+static uint64_t randomNext(uint64_t* state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * RANDOM_MULTIPLIER;
+}
+
+/**
+* randomStateDestroy: Unlinks the random state of an exiting thread from its multi queue, and deallocates it.
+*
+* @param state - The random state of the thread.
+*/
+static void randomStateDestroy(void* state)
+{
+    RandomState random_state = state;
+    MultiQueue multi_queue = random_state->multi_queue;
+    pthread_mutex_lock(&multi_queue->states_lock);
+    if(random_state->previous)
+    {
+        random_state->previous->next = random_state->next;
+    }
+    else
+    {
+        multi_queue->states = random_state->next;
+    }
+    if(random_state->next)
+    {
+        random_state->next->previous = random_state->previous;
+    }
+    pthread_mutex_unlock(&multi_queue->states_lock);
+    free(random_state);
+}
+
+/**
+* randomQueue: Chooses a random queue of the multi queue, using the random state of the calling thread.
+* The state is created on the first call of each thread, seeded by its own address.
+*
+* @param multi_queue - Target multi queue.
+* @return
+* 	The index of the chosen queue.
+*/
+static int randomQueue(MultiQueue multi_queue)
+{
+    RandomState state = pthread_getspecific(multi_queue->random_key);
+    if(!state)
+    {
+        state = malloc(sizeof(*state));
+        if(!state || pthread_setspecific(multi_queue->random_key, state) != 0)
+        {
+            free(state);
+            uint64_t fallback = (uint64_t)(uintptr_t)&fallback * RANDOM_SEED_MIXER | 1;
+            return (int)(randomNext(&fallback) % (uint64_t)multi_queue->queue_count);
+        }
+        state->value = (uint64_t)(uintptr_t)state * RANDOM_SEED_MIXER | 1;
+        state->multi_queue = multi_queue;
+        state->previous = NULL;
+        pthread_mutex_lock(&multi_queue->states_lock);
+        state->next = multi_queue->states;
+        if(state->next)
+        {
+            state->next->previous = state;
+        }
+        multi_queue->states = state;
+        pthread_mutex_unlock(&multi_queue->states_lock);
+    }
+    return (int)(randomNext(&state->value) % (uint64_t)multi_queue->queue_count);
+}
+
+
+MultiQueue mqCreate(const PQOptions* options, int queue_count)
+{
+    if(!options || queue_count <= 0)
+    {
+        return NULL;
+    }
+    MultiQueue multi_queue = malloc(sizeof(*multi_queue));
+    if(!multi_queue)
+    {
+        return NULL;
+    }
+    multi_queue->queues = calloc(queue_count, sizeof(*multi_queue->queues));
+    if(!multi_queue->queues || pthread_mutex_init(&multi_queue->states_lock, NULL) != 0)
+    {
+        free(multi_queue->queues);
+        free(multi_queue);
+        return NULL;
+    }
+    if(pthread_key_create(&multi_queue->random_key, randomStateDestroy) != 0)
+    {
+        pthread_mutex_destroy(&multi_queue->states_lock);
+        free(multi_queue->queues);
+        free(multi_queue);
+        return NULL;
+    }
+    multi_queue->states = NULL;
+    multi_queue->queue_count = queue_count;
+    PQOptions queue_options = *options;
+    queue_options.concurrent = true;
+    queue_options.pool = NULL;
+    for(int i = 0; i < queue_count; i++)
+    {
+        multi_queue->queues[i] = pqCreateEx(&queue_options);
+        if(!multi_queue->queues[i])
+        {
+            mqDestroy(multi_queue);
+            return NULL;
+        }
+    }
+    return multi_queue;
+}
+
+
+void mqDestroy(MultiQueue multi_queue)
+{
+    if(!multi_queue)
+    {
+        return;
+    }
+    for(int i = 0; i < multi_queue->queue_count; i++)
+    {
+        pqDestroy(multi_queue->queues[i]);
+    }
+    pthread_key_delete(multi_queue->random_key);
+    while(multi_queue->states)
+    {
+        RandomState next = multi_queue->states->next;
+        free(multi_queue->states);
+        multi_queue->states = next;
+    }
+    pthread_mutex_destroy(&multi_queue->states_lock);
+    free(multi_queue->queues);
+    free(multi_queue);
+}
+
+
+int mqGetSize(MultiQueue multi_queue)
+{
+    if(!multi_queue)
+    {
+        return -1;
+    }
+    int size = 0;
+    for(int i = 0; i < multi_queue->queue_count; i++)
+    {
+        size += pqGetSize(multi_queue->queues[i]);
+    }
+    return size;
+}
+
+
+PriorityQueueResult mqInsert(MultiQueue multi_queue, PQElement element, PQElementPriority priority)
+{
+    if(!multi_queue)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    return pqInsert(multi_queue->queues[randomQueue(multi_queue)], element, priority);
+}
+
+
+PriorityQueueResult mqExtract(MultiQueue multi_queue, PQElement* element, PQElementPriority* priority)
+{
+    if(!multi_queue || !element)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    int first = randomQueue(multi_queue);
+    int second = randomQueue(multi_queue);
+    if(pqCompareFirst(multi_queue->queues[second], multi_queue->queues[first]) > 0)
+    {
+        first = second;
+    }
+    PriorityQueueResult result = pqExtract(multi_queue->queues[first], element, priority);
+    for(int i = 1; i < multi_queue->queue_count && result == PQ_ELEMENT_DOES_NOT_EXISTS; i++)
+    {
+        result = pqExtract(multi_queue->queues[(first + i) % multi_queue->queue_count], element, priority);
+    }
+    return result;
+}
@@ -0,0 +1,90 @@
+#ifndef MULTI_QUEUE_H_
+#define MULTI_QUEUE_H_
+
+#include <stdbool.h>
+#include "priority_queue.h"
+
+/**
+* Relaxed Concurrent Priority Queue (MultiQueue)
+*
+* Implements a priority queue which can be used by many threads at once, and gives up strict ordering
+* for throughput. The elements are spread over several concurrent priority queues: every insert goes to
+* a random queue, and every extract takes the higher of the first elements of two random queues.
+* An extracted element is not always the highest priority element, but it is close to it - with twice as
+* many queues as threads, it is usually among the few highest priority elements.
+* Threads rarely wait for each other, since they rarely use the same queue at the same time.
+*
+* The following functions are available:
+*   mqCreate		    - Creates a new empty multi queue
+*   mqDestroy		    - Deletes an existing multi queue and frees all resources
+*   mqGetSize		    - Returns the number of elements in a multi queue
+*   mqInsert	        - Inserts an element with a given priority to a random queue
+*   mqExtract		    - Removes a high priority element and returns it without freeing it
+*/
+
+/** Type for defining the multi queue */
+typedef struct MultiQueue_t *MultiQueue;
+
+/**
+* mqCreate: Allocates a new empty multi queue.
+*
+* @param options - The options of the priority queues of the multi queue, see PQOptions. The priority queues
+* 		are always concurrent, and each of them has a node pool of its own.
+* @param queue_count - The number of priority queues, usually twice the number of threads using them.
+* @return
+* 	NULL - if options is NULL or invalid, queue_count is not positive, or allocations failed.
+* 	A new multi queue in case of success.
+*/
+MultiQueue mqCreate(const PQOptions* options, int queue_count);
+
+/**
+* mqDestroy: Deallocates an existing multi queue. Clears all elements by using the free functions.
+* Must not be called while other threads use the multi queue, or while threads which used it exit.
+* The random states of all the threads which used the multi queue are freed, also of threads which are still running.
+*
+* @param multi_queue - Target multi queue to be deallocated. If it is NULL nothing will be done
+*/
+void mqDestroy(MultiQueue multi_queue);
+
+/**
+* mqGetSize: Returns the number of elements in a multi queue. While other threads change the
+* multi queue, the result is only an estimate.
+*
+* @param multi_queue - The multi queue whose size is requested
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of elements in the multi queue.
+*/
+int mqGetSize(MultiQueue multi_queue);
+
+/**
+* mqInsert: Adds a new element with a given priority to a random priority queue of the multi queue.
+*
+* @param multi_queue - The multi queue for which to add the element
+* @param element - The element which needs to be added.
+* @param priority - The priority of the element.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_OUT_OF_MEMORY if an allocation failed (Meaning the function for copying
+* 	an element or priority failed)
+* 	PQ_SUCCESS the element had been inserted successfully
+*/
+PriorityQueueResult mqInsert(MultiQueue multi_queue, PQElement element, PQElementPriority priority);
+
+/**
+* mqExtract: Removes the higher priority first element of two random priority queues of the multi queue,
+* and returns it without freeing it, as in pqExtract. If both priority queues are empty, the element is
+* taken from any priority queue which is not empty.
+*
+* @param multi_queue - The multi queue to remove the element from.
+* @param element - Pointer to assign the removed element into.
+* @param priority - Pointer to assign the priority of the removed element into, or NULL to free it.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as multi_queue or element.
+* 	PQ_ELEMENT_DOES_NOT_EXISTS if the multi queue is empty.
+* 	PQ_OUT_OF_MEMORY if an allocation failed.
+* 	PQ_SUCCESS the element was removed and returned.
+*/
+PriorityQueueResult mqExtract(MultiQueue multi_queue, PQElement* element, PQElementPriority* priority);
+
+#endif /* MULTI_QUEUE_H_ */
@@ -1,391 +1,5800 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "priority_queue.h"
+
+/** Vector compares of keys, with GCC or Clang on x86 - chosen when the CPU supports them */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KEYS_SIMD
+#include <immintrin.h>
+#endif
+
+/** Constants for the node array */
+#define INITIAL_CAPACITY 16
+#define EXPAND_FACTOR 2
+#define INVALID_ITERATOR -1
+
+/** Constants for the hash index - the index is kept at most half full */
+#define INDEX_LOAD_FACTOR 2
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+/** Constants for the node pool - every slab is twice as large as the previous one, up to a limit */
+#define INITIAL_SLAB_NODES 8
+#define MAX_SLAB_NODES 4096
+
+/**
+* Constants for the calendar backend - the number of buckets is kept between half and twice
+* the number of nodes, and a bucket spans about 3 times the average distance between keys
+*/
+#define CALENDAR_MIN_BUCKETS 16
+#define CALENDAR_WIDTH_FACTOR 3
+
+/** Constants for the heap backends - the number of children of a node in a d-ary heap */
+#define BINARY_HEAP_ARITY 2
+#define DEFAULT_ARITY 4
+
+/** Constants for the skip list backend - the number of levels, and the seed of its random numbers */
+#define SKIP_LIST_LEVELS 24
+#define SKIP_LIST_SEED 0x9E3779B97F4A7C15ULL
+
+/** Constants for persistent queues - the seed of the random weights of the version entries */
+#define VERSIONS_SEED 0x2545F4914F6CDD1DULL
+
+/**
+* Constants for the key array - its alignment (a cache line), and the number of keys below which a search
+* stops halving the range and counts the remaining keys with vector compares.
+*/
+#define KEY_ARRAY_ALIGNMENT 64
+#define KEY_ARRAY_SCAN 32
+
+/** Constants for lazy removal - the default ratio of dead nodes to all nodes above which the queue is compacted */
+#define DEFAULT_TOMBSTONE_RATIO 0.25
+
+/**
+* Macros for the operation counters of a queue, which are compiled in only if PQ_STATS is defined.
+* Otherwise the macros are empty, or only run their statement, and their counter arguments are not evaluated.
+* STATS_ADD adds amount to a counter. STATS_SPAN runs a statement and adds to total the amount by which
+* counter grew while it ran. STATS_RESET zeroes all the counters.
+*/
+#ifdef PQ_STATS
+#define STATS_ADD(queue, counter, amount) ((queue)->op_stats.counter += (amount))
+#define STATS_SPAN(queue, total, counter, ...) \
+    do \
+    { \
+        unsigned long stats_start = (queue)->op_stats.counter; \
+        __VA_ARGS__; \
+        (queue)->op_stats.total += (queue)->op_stats.counter - stats_start; \
+    } while(0)
+#define STATS_RESET(queue) memset(&(queue)->op_stats, 0, sizeof((queue)->op_stats))
+#else
+#define STATS_ADD(queue, counter, amount) ((void)0)
+#define STATS_SPAN(queue, total, counter, ...) \
+    do \
+    { \
+        __VA_ARGS__; \
+    } while(0)
+#define STATS_RESET(queue) ((void)0)
+#endif
+
+/** Type for defining Node to the priority queue, which is also the handle of its element */
+typedef struct PQNode_t *Node;
+
+/** Auxiliary union - a unit of memory aligned for any key. Slabs and inline keys are made of units */
+typedef union PQUnit_t {
+    void* pointer;
+    int64_t integer;
+    double floating;
+} Unit;
+
+/**
+* Auxiliary struct for PrioretyQueue - an entry of the queue.
+* The node ends with the links of the backend, if it links its nodes, followed by the key,
+* if the queue keeps its keys inline. In that case priority points to the key.
+*/
+struct PQNode_t {
+    PQElement element;
+    PQElementPriority priority;
+    unsigned long order;
+    int index;
+    unsigned long hash;
+    Unit extra[];
+};
+
+/** Type for defining the links of a node, in backends which link their nodes to each other */
+typedef struct PQLinks_t *Links;
+
+/** Auxiliary struct for the linked backends - the links stored at the end of a node */
+struct PQLinks_t {
+    Node next;
+    Node previous;
+    Node child;
+    int bucket;
+};
+
+/** Type for defining the calendar of a queue which uses the calendar backend */
+typedef struct PQCalendar_t *Calendar;
+
+/**
+* Auxiliary struct for the calendar backend.
+* Every bucket holds a circular list of nodes, sorted by their order in the queue. A key (a day) belongs
+* to bucket (day / width) modulo the number of buckets, so the buckets are the days of a year of
+* bucket_count * width days. The search for the first node starts at the bucket current, in the year
+* in which its days start at the day start. All the nodes are on start or after it.
+* first is the first node, if it is known.
+* The buckets are doubled when the queue grows past grow_size nodes, and halved when it shrinks below
+* shrink_size nodes. If allocating the new buckets fails, the thresholds are moved away from the current
+* size, so the allocation is not retried on every insert or remove.
+*/
+struct PQCalendar_t {
+    Node* buckets;
+    int bucket_count;
+    uint64_t width;
+    int current;
+    uint64_t start;
+    Node first;
+    int grow_size;
+    int shrink_size;
+};
+
+/** Type for defining the key array of a queue which uses the sorted array backend */
+typedef struct PQKeyArray_t *KeyArray;
+
+/**
+* Auxiliary struct for the sorted array backend, with PQ_KEY_INT64 keys - the keys of the nodes array in
+* the same order, in a contiguous array aligned to a cache line, so searching it reads no node.
+* The keys of a queue whose lowest key comes first are stored inverted (~key), so the stored keys are
+* always in descending order. block is the allocation which holds keys, with room for capacity keys.
+*/
+struct PQKeyArray_t {
+    int64_t* keys;
+    void* block;
+    int capacity;
+};
+
+/** Type for defining an index entry of the skip list backend */
+typedef struct PQSkipIndex_t *SkipIndex;
+
+/**
+* Auxiliary struct for the skip list backend - an entry of node in one of the levels above the
+* list of nodes. right is the next entry in the same level, and down is the entry of the same node
+* in the level below it, or NULL in the first level above the list of nodes.
+*/
+struct PQSkipIndex_t {
+    Node node;
+    SkipIndex right;
+    SkipIndex down;
+};
+
+/** Type for defining the skip list of a queue which uses the skip list backend */
+typedef struct PQSkipList_t *SkipList;
+
+/**
+* Auxiliary struct for the skip list backend.
+* The nodes are linked in the order of the queue from first, using their links. Above them are levels of
+* index entries - every node has entries in a random number of levels, each level about half as many as the
+* one below it - so a node is found by moving right and down from the highest level in O(log n).
+* heads[level] is an entry without a node which starts a level, for levels 1 to levels - 1.
+* The index entries are allocated from their own node pool.
+*/
+struct PQSkipList_t {
+    Node first;
+    int levels;
+    uint64_t random;
+    PQNodePool index_pool;
+    struct PQSkipIndex_t heads[SKIP_LIST_LEVELS];
+};
+
+/** Type for defining the backend of a queue, which keeps the nodes in the order of the queue */
+typedef const struct PQBackend_t *Backend;
+
+/** Type for defining a slab of nodes in the node pool */
+typedef struct PQSlab_t *Slab;
+
+/** Auxiliary struct for the node pool - a block of memory holding nodes, followed by the nodes */
+struct PQSlab_t {
+    Slab next;
+    int capacity;
+    Unit units[];
+};
+
+/** Auxiliary struct for the node pool - a free node, linked to the next free node */
+typedef struct FreeNode_t {
+    struct FreeNode_t* next;
+} *FreeNode;
+
+/**
+* Struct representing a pool of nodes.
+* Nodes are allocated from slabs, and freed nodes are kept in a free list for reuse.
+* The nodes of the newest slab are handed out in order, until the slab is full.
+* The pool is reference counted, since it can be shared by several queues.
+* All the nodes of a pool have the same size, in units, which is set by the first queue using it.
+*/
+struct PQNodePool_t {
+    int node_units;
+    Slab slabs;
+    FreeNode free_list;
+    int slab_used;
+    int next_slab_capacity;
+    int capacity;
+    int used;
+    int high_water_mark;
+    int ref_count;
+};
+
+/**
+* Struct representing an external iterator - the nodes of its queue in order, copied when it was created.
+* The iterator is valid while the generation of the queue equals its generation.
+*/
+struct PQIterator_t {
+    PriorityQueue queue;
+    unsigned long generation;
+    int position;
+    int size;
+    Node nodes[];
+};
+
+/** Type for defining the lock of a concurrent queue */
+typedef struct PQLock_t *Lock;
+
+/**
+* Struct representing the lock of a concurrent queue.
+* The lock is reference counted, since it is shared by the copy-on-write copies of the queue.
+*/
+struct PQLock_t {
+    pthread_mutex_t mutex;
+    int ref_count;
+};
+
+/** Type for defining an entry of a version of a persistent queue */
+typedef struct PQVersionEntry_t *VersionEntry;
+
+/**
+* Auxiliary struct for persistent queues - an entry of a version of the queue, with the element, priority
+* and order which its node had in that version. The entries of a version form a treap, a search tree in
+* the order of the queue which is also a heap by the random weights of the entries.
+* Entries are never changed once they are in a version: a change copies the entries on the path to the
+* changed entry, and shares all the other entries with the previous version. Every entry counts the
+* versions and entries which refer to it. An inline key is copied into the entry, and priority points to it.
+*/
+struct PQVersionEntry_t {
+    PQElement element;
+    PQElementPriority priority;
+    unsigned long order;
+    uint32_t weight;
+    int ref_count;
+    VersionEntry left;
+    VersionEntry right;
+    Unit key[];
+};
+
+/**
+* Struct representing a snapshot - a version of a persistent queue, pinned until it is released.
+* The snapshots of a queue are linked from the oldest to the newest, and numbered by sequence.
+*/
+struct PQSnapshot_t {
+    PriorityQueue queue;
+    VersionEntry root;
+    int size;
+    unsigned long sequence;
+    PQSnapshot older;
+    PQSnapshot newer;
+};
+
+/** Type for defining the versions of a persistent queue */
+typedef struct PQVersions_t *Versions;
+
+/**
+* Auxiliary struct for persistent queues.
+* root is the current version, and the entries of all the versions are allocated from entry_pool.
+* Nodes which were removed while the queue had snapshots are retired instead of freed, since the
+* snapshots may still see their element and priority. A retired node keeps, in its order, the sequence
+* of the newest snapshot when it was retired, and it is freed once the snapshots up to that one are released.
+*/
+struct PQVersions_t {
+    VersionEntry root;
+    PQNodePool entry_pool;
+    uint64_t random;
+    unsigned long sequence;
+    PQSnapshot oldest;
+    PQSnapshot newest;
+    Node* retired;
+    int retired_count;
+    int retired_capacity;
+};
+
+/**
+* Struct representing Generic Priorety Queue.
+* The nodes are kept in the nodes array, in which every node knows its index. The backend orders
+* the nodes: the heap backends arrange the array itself as a heap with arity children for each node,
+* so inserting and removing the first element takes O(log n). The sorted array backend keeps the array
+* sorted, with a copy of the keys in key_array if they are PQ_KEY_INT64 keys. The calendar backend links
+* the nodes in buckets by their keys, the skip list backend links them in order under the levels
+* of skip_list, and the pairing heap backend links them in a tree whose root is root.
+* Unless the nodes array is sorted, iteration goes through the sorted
+* array, which is rebuilt from the nodes only when the queue is iterated after a change.
+* Every change increases the generation of the queue, so the sorted array and the iterator
+* are known to be up to date when their generation equals the generation of the queue.
+* If the queue was created with a hash function, the nodes are also kept in an open addressing
+* hash index (linear probing), which is used to find nodes by their element.
+* If key_type is not PQ_KEY_POINTER, the priorities are keys of key_size bytes stored inline in the
+* nodes, and they are compared without the priority functions.
+* A copy of a queue in copy-on-write mode shares the nodes array, the nodes, the hash index,
+* the calendar and the skip list with the original. The number of queues sharing them is counted by sharers, and a queue
+* which is about to change them makes its own copy first.
+* A concurrent queue has a lock, which every public function holds while it uses the queue. Copies which
+* share the nodes share the lock too, since they change the count of sharers and the node pool.
+* A persistent queue also keeps its versions, which every change updates in O(log n), so that
+* snapshots of the queue can be taken in O(1).
+* If the queue was given size functions, element_bytes and priority_bytes count the memory of the elements
+* and priorities it holds, and peak_bytes the most memory its nodes, elements and priorities held at once.
+* If the library is compiled with PQ_STATS, op_stats counts the operations of the queue, see STATS_ADD.
+* With lazy removal, elements removed by pqRemoveElement and pqRemoveByHandle are freed at once, but their
+* nodes stay in the backend as dead nodes (tombstones), whose element is NULL, until the queue is compacted.
+* dead counts them, and they are not in the hash index. The first node is never dead, so a queue with
+* nodes has live elements. Copy-on-write copies share no dead nodes, since a queue is compacted before it is shared.
+*/
+struct PriorityQueue_t {
+    Node* nodes;
+    int size;
+    int capacity;
+    unsigned long next_order;
+    unsigned long generation;
+    Node* sorted;
+    unsigned long sorted_generation;
+    CopyPQElement copy_element;
+    FreePQElement free_element;
+    EqualPQElements equal_elements;
+    CopyPQElementPriority copy_priority;
+    FreePQElementPriority free_priority;
+    ComparePQElementPriorities compare_priorities;
+    PQKeyType key_type;
+    int key_size;
+    bool lowest_first;
+    PQBackendType backend_type;
+    Backend backend;
+    int key_offset;
+    int arity;
+    Calendar calendar;
+    SkipList skip_list;
+    KeyArray key_array;
+    Node root;
+    HashPQElement hash_element;
+    Node* index;
+    int index_capacity;
+    PQNodePool pool;
+    bool copy_on_write;
+    int* sharers;
+    Lock lock;
+    Versions versions;
+    SizePQElement size_element;
+    SizePQElementPriority size_priority;
+    size_t element_bytes;
+    size_t priority_bytes;
+    size_t peak_bytes;
+    bool lazy_removal;
+    double tombstone_ratio;
+    int dead;
+#ifdef PQ_STATS
+    PQOpStats op_stats;
+#endif
+    int iterator;
+    unsigned long iterator_generation;
+};
+
+/**
+* Struct representing a backend - the functions which keep the nodes of a queue in order.
+* The nodes are kept in the nodes array in any case, and the backend may order the array itself
+* or link the nodes.
+* linked - true if the nodes hold links.
+* sorted - true if the nodes array is kept in the order of the queue.
+* linear_build - true if build is cheaper than inserting many nodes one by one. It takes O(n) for the
+*       heaps, and O(n log n) for the sorted array, whose inserts take O(n).
+* create, destroy - Allocate and deallocate the structure of the backend, NULL if it has none.
+* insert - Adds a node which was put at the end of the nodes array.
+* remove - Removes a node from the backend and from the nodes array.
+* fix - Moves a node after its priority or order was changed.
+* build - Arranges all the nodes of the nodes array, ignoring their previous arrangement.
+* first - Returns the first node of a non-empty queue.
+* peek - Fills an array with the first k nodes in order, without changing the queue. Returns false if an
+*       allocation failed.
+*/
+struct PQBackend_t {
+    bool linked;
+    bool sorted;
+    bool linear_build;
+    bool (*create)(PriorityQueue queue);
+    void (*destroy)(PriorityQueue queue);
+    void (*insert)(PriorityQueue queue, Node node);
+    void (*remove)(PriorityQueue queue, Node node);
+    void (*fix)(PriorityQueue queue, Node node);
+    void (*build)(PriorityQueue queue);
+    Node (*first)(PriorityQueue queue);
+    bool (*peek)(PriorityQueue queue, Node* nodes, int k);
+};
+
+/**
+* lockCreate: Allocates a new lock, held by no thread, with one reference.
+*
+* @return
+* 	NULL if an allocation failed.
+* 	A new lock otherwise.
+*/
+static Lock lockCreate()
+{
+    Lock lock = malloc(sizeof(*lock));
+    if(!lock)
+    {
+        return NULL;
+    }
+    if(pthread_mutex_init(&lock->mutex, NULL) != 0)
+    {
+        free(lock);
+        return NULL;
+    }
+    lock->ref_count = 1;
+    return lock;
+}
+
+/**
+* lockAcquire: Waits until the lock is free and takes it. Does nothing for a NULL lock.
+*
+* @param lock - The lock to take, or NULL.
+*/
+static void lockAcquire(Lock lock)
+{
+    if(lock)
+    {
+        pthread_mutex_lock(&lock->mutex);
+    }
+}
+
+/**
+* lockRelease: Frees a lock taken by lockAcquire. Does nothing for a NULL lock.
+*
+* @param lock - The lock to free, or NULL.
+*/
+static void lockRelease(Lock lock)
+{
+    if(lock)
+    {
+        pthread_mutex_unlock(&lock->mutex);
+    }
+}
+
+/**
+* lockDrop: Frees a lock taken by lockAcquire and drops a reference to it.
+*           The lock is deallocated when its last reference is dropped.
+*
+* @param lock - The lock to drop, or NULL.
+*/
+static void lockDrop(Lock lock)
+{
+    if(!lock)
+    {
+        return;
+    }
+    bool last = --lock->ref_count == 0;
+    pthread_mutex_unlock(&lock->mutex);
+    if(last)
+    {
+        pthread_mutex_destroy(&lock->mutex);
+        free(lock);
+    }
+}
+
+/**
+* queueLock: Takes the lock of a concurrent queue. Does nothing for a NULL queue or a queue without a lock.
+*
+* @param queue - Target priority queue, or NULL.
+*/
+static void queueLock(PriorityQueue queue)
+{
+    if(queue)
+    {
+        lockAcquire(queue->lock);
+    }
+}
+
+/**
+* queueUnlock: Frees the lock taken by queueLock.
+*
+* @param queue - Target priority queue, or NULL.
+*/
+static void queueUnlock(PriorityQueue queue)
+{
+    if(queue)
+    {
+        lockRelease(queue->lock);
+    }
+}
+
+/**
+* queueLockPair: Takes the locks of two queues, in the order of their addresses so that two threads locking
+*           the same pair never wait for each other. A lock shared by both queues is taken once.
+*
+* @param queue1 - The first priority queue.
+* @param queue2 - The second priority queue.
+*/
+static void queueLockPair(PriorityQueue queue1, PriorityQueue queue2)
+{
+    Lock first = queue1->lock, second = queue2->lock;
+    if((uintptr_t)first > (uintptr_t)second)
+    {
+        first = queue2->lock;
+        second = queue1->lock;
+    }
+    lockAcquire(first);
+    if(second != first)
+    {
+        lockAcquire(second);
+    }
+}
+
+/**
+* queueUnlockPair: Frees the locks taken by queueLockPair.
+*
+* @param queue1 - The first priority queue.
+* @param queue2 - The second priority queue.
+*/
+static void queueUnlockPair(PriorityQueue queue1, PriorityQueue queue2)
+{
+    lockRelease(queue1->lock);
+    if(queue2->lock != queue1->lock)
+    {
+        lockRelease(queue2->lock);
+    }
+}
+
+/**
+* poolAllocate: Takes a node from the node pool. A freed node is reused if there is one,
+*           otherwise the node is taken from the newest slab, and a new slab is allocated if it is full.
+*
+* @param pool - Target node pool.
+* @return
+* 	NULL - if an allocation failed.
+* 	An uninitialized node in case of success.
+*/
+static Node poolAllocate(PQNodePool pool)
+{
+    Node node = NULL;
+    if(pool->free_list)
+    {
+        node = (Node)pool->free_list;
+        pool->free_list = pool->free_list->next;
+    }
+    else
+    {
+        if(!pool->slabs || pool->slab_used == pool->slabs->capacity)
+        {
+            Slab slab = malloc(sizeof(*slab) + pool->next_slab_capacity * pool->node_units * sizeof(slab->units[0]));
+            if(!slab)
+            {
+                return NULL;
+            }
+            slab->capacity = pool->next_slab_capacity;
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            pool->slab_used = 0;
+            pool->capacity += slab->capacity;
+            if(pool->next_slab_capacity < MAX_SLAB_NODES)
+            {
+                pool->next_slab_capacity *= EXPAND_FACTOR;
+            }
+        }
+        node = (Node)&pool->slabs->units[pool->slab_used++ * pool->node_units];
+    }
+    pool->used++;
+    if(pool->used > pool->high_water_mark)
+    {
+        pool->high_water_mark = pool->used;
+    }
+    return node;
+}
+
+/**
+* poolFree: Returns a node to the free list of the node pool.
+*
+* @param pool - The node pool which the node was taken from.
+* @param node - The node to return.
+*/
+static void poolFree(PQNodePool pool, Node node)
+{
+    FreeNode free_node = (FreeNode)node;
+    free_node->next = pool->free_list;
+    pool->free_list = free_node;
+    pool->used--;
+}
+
+/**
+* poolRelease: Deallocates all the slabs of the node pool at once. All the nodes
+*           taken from the pool must not be used afterwards.
+*
+* @param pool - Target node pool.
+*/
+static void poolRelease(PQNodePool pool)
+{
+    while(pool->slabs)
+    {
+        Slab to_delete = pool->slabs;
+        pool->slabs = to_delete->next;
+        free(to_delete);
+    }
+    pool->free_list = NULL;
+    pool->slab_used = 0;
+    pool->next_slab_capacity = INITIAL_SLAB_NODES;
+    pool->capacity = 0;
+    pool->used = 0;
+}
+
+/**
+* queueNodeUnits: Returns the size of the nodes of the queue, in units, with their links and inline keys.
+*
+* @param queue - Target priority queue.
+* @return
+* 	The number of units in a node.
+*/
+static int queueNodeUnits(PriorityQueue queue)
+{
+    return (sizeof(struct PQNode_t) + queue->key_offset * sizeof(Unit) + queue->key_size + sizeof(Unit) - 1) /
+           sizeof(Unit);
+}
+
+/**
+* nodeLinks: Returns the links of a node, in a queue with a linked backend.
+*
+* @param node - Target node.
+* @return
+* 	The links of the node.
+*/
+static Links nodeLinks(Node node)
+{
+    return (Links)node->extra;
+}
+
+/**
+* keyIsInline: Checks if the priorities of the queue are stored inline in the nodes.
+*
+* @param queue - Target priority queue.
+* @return
+* 	true if the keys are inline.
+* 	Otherwise false.
+*/
+static bool keyIsInline(PriorityQueue queue)
+{
+    return queue->key_type != PQ_KEY_POINTER;
+}
+
+/**
+* keyCompare: Compares two priorities of the queue. Inline keys are compared directly,
+*           other priorities using the compare function of the queue.
+*
+* @param queue - The priority queue which the priorities belong to.
+* @param priority1 - The first priority.
+* @param priority2 - The second priority.
+* @return
+* 	A positive integer if priority1 is higher, 0 if they're equal, and a negative integer otherwise.
+*/
+static int keyCompare(PriorityQueue queue, PQElementPriority priority1, PQElementPriority priority2)
+{
+    int result = 0;
+    STATS_ADD(queue, key_comparisons, 1);
+    if(queue->key_type == PQ_KEY_INT64)
+    {
+        int64_t key1 = *(int64_t*)priority1;
+        int64_t key2 = *(int64_t*)priority2;
+        result = (key1 > key2) - (key1 < key2);
+    }
+    else if(queue->key_type == PQ_KEY_BYTES)
+    {
+        result = memcmp(priority1, priority2, queue->key_size);
+    }
+    else
+    {
+        STATS_ADD(queue, compare_calls, 1);
+        return queue->compare_priorities(priority1, priority2);
+    }
+    return queue->lowest_first ? -result : result;
+}
+
+/**
+* keyCopy: Copies a priority using the copy function of the queue. Inline keys are not copied,
+*           since they are copied into the node itself when it is set.
+*
+* @param queue - The priority queue which the priority belongs to.
+* @param priority - The priority to copy.
+* @return
+* 	NULL - if the allocation failed.
+* 	The priority to set in the node in case of success.
+*/
+static PQElementPriority keyCopy(PriorityQueue queue, PQElementPriority priority)
+{
+    if(keyIsInline(queue))
+    {
+        return priority;
+    }
+    STATS_ADD(queue, priority_copies, 1);
+    return queue->copy_priority(priority);
+}
+
+/**
+* keysCountScalar: Counts the keys of an array which are greater than key, or greater or equal if inclusive.
+*
+* @param keys - The keys.
+* @param count - The number of keys.
+* @param key - The key to compare with.
+* @param inclusive - true to count the keys equal to key too.
+* @return
+* 	The number of keys.
+*/
+static int keysCountScalar(const int64_t* keys, int count, int64_t key, bool inclusive)
+{
+    int result = 0;
+    for(int i = 0; i < count; i++)
+    {
+        result += inclusive ? keys[i] >= key : keys[i] > key;
+    }
+    return result;
+}
+
+#ifdef KEYS_SIMD
+/**
+* keysCountAvx2: keysCountScalar, comparing 4 keys at once with AVX2.
+*/
+static __attribute__((target("avx2"))) int keysCountAvx2(const int64_t* keys, int count, int64_t key,
+                                                          bool inclusive)
+{
+    __m256i target = _mm256_set1_epi64x(key);
+    int result = 0;
+    int i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(keys + i));
+        __m256i greater = inclusive ? _mm256_cmpgt_epi64(target, block) : _mm256_cmpgt_epi64(block, target);
+        int bits = _mm256_movemask_pd(_mm256_castsi256_pd(greater));
+        result += __builtin_popcount(inclusive ? ~bits & 0xF : bits);
+    }
+    return result + keysCountScalar(keys + i, count - i, key, inclusive);
+}
+
+/**
+* keysCountSse42: keysCountScalar, comparing 2 keys at once with SSE4.2.
+*/
+static __attribute__((target("sse4.2"))) int keysCountSse42(const int64_t* keys, int count, int64_t key,
+                                                            bool inclusive)
+{
+    __m128i target = _mm_set1_epi64x(key);
+    int result = 0;
+    int i = 0;
+    for(; i + 2 <= count; i += 2)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)(keys + i));
+        __m128i greater = inclusive ? _mm_cmpgt_epi64(target, block) : _mm_cmpgt_epi64(block, target);
+        int bits = _mm_movemask_pd(_mm_castsi128_pd(greater));
+        result += __builtin_popcount(inclusive ? ~bits & 0x3 : bits);
+    }
+    return result + keysCountScalar(keys + i, count - i, key, inclusive);
+}
+#endif
+
+/**
+* keysCount: keysCountScalar, using the widest vector compares which the CPU supports.
+*/
+static int keysCount(const int64_t* keys, int count, int64_t key, bool inclusive)
+{
+#ifdef KEYS_SIMD
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return keysCountAvx2(keys, count, key, inclusive);
+    }
+    if(__builtin_cpu_supports("sse4.2"))
+    {
+        return keysCountSse42(keys, count, key, inclusive);
+    }
+#endif
+    return keysCountScalar(keys, count, key, inclusive);
+}
+
+/**
+* keyArrayKey: Returns a priority of the queue as it is stored in the key array.
+*
+* @param queue - The priority queue, with PQ_KEY_INT64 keys.
+* @param priority - The priority.
+* @return
+* 	The stored key.
+*/
+static int64_t keyArrayKey(PriorityQueue queue, PQElementPriority priority)
+{
+    int64_t key = *(int64_t*)priority;
+    return queue->lowest_first ? ~key : key;
+}
+
+/**
+* keyArrayRank: Counts the first keys of a key array which are greater than key, or greater or equal
+*           if inclusive. Since the keys are in descending order, this is the index at which they stop.
+*           Halves the range in O(log n) and counts the last KEY_ARRAY_SCAN keys with vector compares.
+*
+* @param key_array - Target key array.
+* @param count - The number of keys in the array.
+* @param key - The stored key to compare with.
+* @param inclusive - true to count the keys equal to key too.
+* @return
+* 	The number of keys.
+*/
+static int keyArrayRank(KeyArray key_array, int count, int64_t key, bool inclusive)
+{
+    const int64_t* keys = key_array->keys;
+    int low = 0;
+    int high = count;
+    while(high - low > KEY_ARRAY_SCAN)
+    {
+        int middle = low + (high - low) / 2;
+        if(inclusive ? keys[middle] >= key : keys[middle] > key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low + keysCount(keys + low, high - low, key, inclusive);
+}
+
+/**
+* keyArrayReserve: Makes sure a key array has room for capacity keys. The keys are moved to a new
+*           aligned block, since realloc does not keep the alignment.
+*
+* @param key_array - Target key array.
+* @param capacity - The number of keys.
+* @param count - The number of keys to keep.
+* @return
+* 	false if the allocation failed, the key array is not changed.
+* 	Otherwise true.
+*/
+static bool keyArrayReserve(KeyArray key_array, int capacity, int count)
+{
+    if(capacity <= key_array->capacity)
+    {
+        return true;
+    }
+    void* block = malloc(capacity * sizeof(int64_t) + KEY_ARRAY_ALIGNMENT - 1);
+    if(!block)
+    {
+        return false;
+    }
+    int64_t* keys = (int64_t*)(((uintptr_t)block + KEY_ARRAY_ALIGNMENT - 1) &
+                               ~(uintptr_t)(KEY_ARRAY_ALIGNMENT - 1));
+    if(count > 0)
+    {
+        memcpy(keys, key_array->keys, count * sizeof(*keys));
+    }
+    free(key_array->block);
+    key_array->block = block;
+    key_array->keys = keys;
+    key_array->capacity = capacity;
+    return true;
+}
+
+/**
+* keyFree: Frees a priority using the free function of the queue. Inline keys are freed with their node.
+*
+* @param queue - The priority queue which the priority belongs to.
+* @param priority - The priority to free.
+*/
+static void keyFree(PriorityQueue queue, PQElementPriority priority)
+{
+    if(!keyIsInline(queue))
+    {
+        queue->free_priority(priority);
+    }
+}
+
+/**
+* nodeSetKey: Sets the priority of a node. An inline key is copied into the node,
+*           otherwise the node holds priority itself.
+*
+* @param queue - The priority queue which holds the node.
+* @param node - Target node.
+* @param priority - The priority to set.
+*/
+static void nodeSetKey(PriorityQueue queue, Node node, PQElementPriority priority)
+{
+    if(keyIsInline(queue))
+    {
+        Unit* key = node->extra + queue->key_offset;
+        memcpy(key, priority, queue->key_size);
+        priority = key;
+    }
+    node->priority = priority;
+}
+
+/**
+* queueCount: Adds the memory of an element and a priority to the memory counted by the queue, or takes it away.
+*           Only memory measured by the size functions of the queue is counted, so inline keys are not.
+*
+* @param queue - Target priority queue.
+* @param element - The element, or NULL.
+* @param priority - The priority, or NULL.
+* @param add - true to add the memory, false to take it away.
+*/
+static void queueCount(PriorityQueue queue, PQElement element, PQElementPriority priority, bool add)
+{
+    if(element && queue->size_element)
+    {
+        size_t bytes = queue->size_element(element);
+        queue->element_bytes = add ? queue->element_bytes + bytes : queue->element_bytes - bytes;
+    }
+    if(priority && queue->size_priority && !keyIsInline(queue))
+    {
+        size_t bytes = queue->size_priority(priority);
+        queue->priority_bytes = add ? queue->priority_bytes + bytes : queue->priority_bytes - bytes;
+    }
+}
+
+/**
+* queueUsage: Returns the memory held by the nodes of the queue, including retired nodes, and by the
+*           elements and priorities counted by the queue.
+*
+* @param queue - Target priority queue.
+* @return
+* 	The number of bytes.
+*/
+static size_t queueUsage(PriorityQueue queue)
+{
+    int nodes = queue->size + (queue->versions ? queue->versions->retired_count : 0);
+    return (size_t)nodes * queueNodeUnits(queue) * sizeof(Unit) + queue->element_bytes + queue->priority_bytes;
+}
+
+/**
+* queueUpdatePeak: Records the memory held by the queue, if it is the most it has held so far.
+*
+* @param queue - Target priority queue.
+*/
+static void queueUpdatePeak(PriorityQueue queue)
+{
+    size_t usage = queueUsage(queue);
+    if(usage > queue->peak_bytes)
+    {
+        queue->peak_bytes = usage;
+    }
+}
+
+/**
+* nodeAdopt: Allocates a new node element from the node pool of the queue, which holds
+*           element and priority themselves. The node takes ownership of them only if it was created.
+*           An inline key is copied into the node, so it stays owned by the caller.
+*
+* @param queue - The priority queue which will hold the node.
+* @param element - a PQElement to be held by the new node element
+* @param priorety - a PQElementPriorety to be held by the new node element
+* @return
+* 	NULL - if the allocation failed.
+* 	A new Node in case of success.
+*/
+static Node nodeAdopt(PriorityQueue queue, PQElement element, PQElementPriority priority)
+{
+    Node node = poolAllocate(queue->pool);
+    if(!node)
+    {
+        return NULL;
+    }
+    STATS_ADD(queue, node_allocations, 1);
+    node->element = element;
+    nodeSetKey(queue, node, priority);
+    node->order = 0;
+    node->index = 0;
+    node->hash = 0;
+    queueCount(queue, node->element, node->priority, true);
+    return node;
+}
+
+/**
+* nodeCreate: Allocates a new node element from the node pool of the queue, which holds
+*           copies of element and priority made by the copy functions of the queue.
+*
+* @param queue - The priority queue which will hold the node.
+* @param element - a PQElement to be held by the new node element
+* @param priorety - a PQElementPriorety to be held by the new node element
+* @return
+* 	NULL - if one of the parameters is NULL or allocations failed.
+* 	A new Node in case of success.
+*/
+static Node nodeCreate(PriorityQueue queue, PQElement element, PQElementPriority priority)
+{
+    if(!element || !priority)
+    {
+        return NULL;
+    }
+    STATS_ADD(queue, element_copies, 1);
+    PQElement new_element = queue->copy_element(element);
+    if(!new_element)
+    {
+        return NULL;
+    }
+    PQElementPriority new_priorety = keyCopy(queue, priority);
+    if(!new_priorety)
+    {
+        queue->free_element(new_element);
+        return NULL;
+    }
+    Node node = nodeAdopt(queue, new_element, new_priorety);
+    if(!node)
+    {
+        queue->free_element(new_element);
+        keyFree(queue, new_priorety);
+        return NULL;
+    }
+    return node;
+}
+
+/**
+* nodeDestroy: Deallocates a node and the element and priority held by it. A dead node holds no element.
+*
+* @param queue - The priority queue which holds the node.
+* @param node - The node to deallocate.
+*/
+static void nodeDestroy(PriorityQueue queue, Node node)
+{
+    queueCount(queue, node->element, node->priority, false);
+    if(node->element)
+    {
+        queue->free_element(node->element);
+    }
+    keyFree(queue, node->priority);
+    poolFree(queue->pool, node);
+}
+
+/**
+* nodeIsBefore: Checks which of two nodes comes first in the priority queue.
+*           The node with the higher priority comes first, and between two equal
+*           priorities the node which was inserted first.
+*
+* @param queue - The priority queue which holds the nodes.
+* @param node1 - The first node.
+* @param node2 - The second node.
+* @return
+* 	true if node1 comes before node2.
+* 	Otherwise false.
+*/
+static bool nodeIsBefore(PriorityQueue queue, Node node1, Node node2)
+{
+    int result = keyCompare(queue, node1->priority, node2->priority);
+    return result > 0 || (result == 0 && node1->order < node2->order);
+}
+
+/**
+* nodePlace: Puts a node at index of the nodes array and updates the index saved in the node.
+*
+* @param queue - Target priority queue.
+* @param node - The node to put.
+* @param index - The index in the nodes array.
+*/
+static void nodePlace(PriorityQueue queue, Node node, int index)
+{
+    queue->nodes[index] = node;
+    node->index = index;
+}
+
+/**
+* nodesReserve: Makes sure the nodes array has room for count more nodes, doubling it as needed.
+*
+* @param queue - Target priority queue.
+* @param count - The number of nodes to make room for.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool nodesReserve(PriorityQueue queue, int count)
+{
+    if(queue->size + count <= queue->capacity)
+    {
+        return true;
+    }
+    int new_capacity = queue->capacity;
+    while(new_capacity < queue->size + count)
+    {
+        new_capacity *= EXPAND_FACTOR;
+    }
+    if(queue->key_array && !keyArrayReserve(queue->key_array, new_capacity, queue->size))
+    {
+        return false;
+    }
+    Node* new_nodes = realloc(queue->nodes, new_capacity * sizeof(*new_nodes));
+    if(!new_nodes)
+    {
+        return false;
+    }
+    queue->nodes = new_nodes;
+    queue->capacity = new_capacity;
+    return true;
+}
+
+/**
+* nodesRemove: Removes a node from the nodes array, by moving the last node to its place.
+*
+* @param queue - Target priority queue.
+* @param node - The node to remove.
+*/
+static void nodesRemove(PriorityQueue queue, Node node)
+{
+    queue->size--;
+    if(node->index != queue->size)
+    {
+        nodePlace(queue, queue->nodes[queue->size], node->index);
+    }
+}
+
+/**
+* nodesMerge: Merges two sorted runs of an array of nodes, in O(size).
+*
+* @param queue - The priority queue which holds the nodes.
+* @param nodes - The array, sorted before middle and from middle onwards.
+* @param temp - An array with room for size nodes, used for merging.
+* @param middle - The index of the first node of the second run.
+* @param size - The number of nodes in the array.
+*/
+static void nodesMerge(PriorityQueue queue, Node* nodes, Node* temp, int middle, int size)
+{
+    int left = 0, right = middle, merged = 0;
+    while(left < middle && right < size)
+    {
+        if(nodeIsBefore(queue, nodes[right], nodes[left]))
+        {
+            temp[merged++] = nodes[right++];
+        }
+        else
+        {
+            temp[merged++] = nodes[left++];
+        }
+    }
+    while(left < middle)
+    {
+        temp[merged++] = nodes[left++];
+    }
+    for(int i = 0; i < merged; i++)
+    {
+        nodes[i] = temp[i];
+    }
+}
+
+/**
+* nodesMergeSort: Sorts an array of nodes by their order in the priority queue.
+*
+* @param queue - The priority queue which holds the nodes.
+* @param nodes - The array to sort.
+* @param temp - An array of the same size, used for merging.
+* @param size - The number of nodes in the array.
+*/
+static void nodesMergeSort(PriorityQueue queue, Node* nodes, Node* temp, int size)
+{
+    if(size < 2)
+    {
+        return;
+    }
+    int middle = size / 2;
+    nodesMergeSort(queue, nodes, temp, middle);
+    nodesMergeSort(queue, nodes + middle, temp, size - middle);
+    nodesMerge(queue, nodes, temp, middle, size);
+}
+
+/**
+* nodesSort: Sorts an array of nodes by their order in the priority queue.
+*
+* @param queue - The priority queue which holds the nodes.
+* @param nodes - The array to sort.
+* @param size - The number of nodes in the array.
+* @return
+* 	false if an allocation failed, the array was not changed.
+* 	Otherwise true.
+*/
+static bool nodesSort(PriorityQueue queue, Node* nodes, int size)
+{
+    if(size < 2)
+    {
+        return true;
+    }
+    Node* temp = malloc(size * sizeof(*temp));
+    if(!temp)
+    {
+        return false;
+    }
+    nodesMergeSort(queue, nodes, temp, size);
+    free(temp);
+    return true;
+}
+
+/**
+* candidatesSiftDown: Moves a node down a binary heap of candidate nodes, in which the first node is at the top.
+*
+* @param queue - The priority queue which holds the nodes.
+* @param candidates - The heap of candidates.
+* @param count - The number of candidates.
+* @param index - The index of the node to move.
+*/
+static void candidatesSiftDown(PriorityQueue queue, Node* candidates, int count, int index)
+{
+    Node node = candidates[index];
+    while(2 * index + 1 < count)
+    {
+        int child = 2 * index + 1;
+        if(child + 1 < count && nodeIsBefore(queue, candidates[child + 1], candidates[child]))
+        {
+            child++;
+        }
+        if(!nodeIsBefore(queue, candidates[child], node))
+        {
+            break;
+        }
+        candidates[index] = candidates[child];
+        index = child;
+    }
+    candidates[index] = node;
+}
+
+/**
+* candidatesPush: Adds a node to a binary heap of candidate nodes.
+*
+* @param queue - The priority queue which holds the nodes.
+* @param candidates - The heap of candidates, with room for another node.
+* @param count - Pointer to the number of candidates, which is increased.
+* @param node - The node to add.
+*/
+static void candidatesPush(PriorityQueue queue, Node* candidates, int* count, Node node)
+{
+    int index = (*count)++;
+    while(index > 0 && nodeIsBefore(queue, node, candidates[(index - 1) / 2]))
+    {
+        candidates[index] = candidates[(index - 1) / 2];
+        index = (index - 1) / 2;
+    }
+    candidates[index] = node;
+}
+
+/**
+* candidatesPop: Removes the first node from a non-empty binary heap of candidate nodes.
+*
+* @param queue - The priority queue which holds the nodes.
+* @param candidates - The heap of candidates.
+* @param count - Pointer to the number of candidates, which is decreased.
+* @return
+* 	The first candidate.
+*/
+static Node candidatesPop(PriorityQueue queue, Node* candidates, int* count)
+{
+    Node first = candidates[0];
+    candidates[0] = candidates[--(*count)];
+    if(*count > 0)
+    {
+        candidatesSiftDown(queue, candidates, *count, 0);
+    }
+    return first;
+}
+
+/**
+* nodesSelect: Fills an array with the first k nodes of the queue in order, by arranging a copy of all the
+*           nodes as a binary heap in O(n) and removing k nodes from it in O(k log n).
+*
+* @param queue - Target priority queue, with at least k nodes.
+* @param nodes - The array to fill.
+* @param k - The number of nodes to fill.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool nodesSelect(PriorityQueue queue, Node* nodes, int k)
+{
+    int count = queue->size;
+    Node* candidates = malloc(count * sizeof(*candidates));
+    if(!candidates)
+    {
+        return false;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        candidates[i] = queue->nodes[i];
+    }
+    for(int i = count / 2 - 1; i >= 0; i--)
+    {
+        candidatesSiftDown(queue, candidates, count, i);
+    }
+    for(int i = 0; i < k; i++)
+    {
+        nodes[i] = candidatesPop(queue, candidates, &count);
+    }
+    free(candidates);
+    return true;
+}
+
+/**
+* heapSiftUp: Moves the node at index up the heap until its parent comes before it.
+*
+* @param queue - Target priority queue.
+* @param index - The index of the node to move.
+*/
+static void heapSiftUp(PriorityQueue queue, int index)
+{
+    Node node = queue->nodes[index];
+    while(index > 0)
+    {
+        int parent = (index - 1) / queue->arity;
+        if(!nodeIsBefore(queue, node, queue->nodes[parent]))
+        {
+            break;
+        }
+        nodePlace(queue, queue->nodes[parent], index);
+        index = parent;
+    }
+    nodePlace(queue, node, index);
+}
+
+/**
+* heapSiftDown: Moves the node at index down the heap until it comes before its children.
+*
+* @param queue - Target priority queue.
+* @param index - The index of the node to move.
+*/
+static void heapSiftDown(PriorityQueue queue, int index)
+{
+    Node node = queue->nodes[index];
+    while(queue->arity * index + 1 < queue->size)
+    {
+        int child = queue->arity * index + 1;
+        int last = child + queue->arity < queue->size ? child + queue->arity : queue->size;
+        for(int sibling = child + 1; sibling < last; sibling++)
+        {
+            if(nodeIsBefore(queue, queue->nodes[sibling], queue->nodes[child]))
+            {
+                child = sibling;
+            }
+        }
+        if(!nodeIsBefore(queue, queue->nodes[child], node))
+        {
+            break;
+        }
+        nodePlace(queue, queue->nodes[child], index);
+        index = child;
+    }
+    nodePlace(queue, node, index);
+}
+
+/**
+* heapFix: Moves the node at index up or down the heap after its priority or order was changed.
+*
+* @param queue - Target priority queue.
+* @param index - The index of the node to move.
+*/
+static void heapFix(PriorityQueue queue, int index)
+{
+    if(index > 0 && nodeIsBefore(queue, queue->nodes[index], queue->nodes[(index - 1) / queue->arity]))
+    {
+        heapSiftUp(queue, index);
+    }
+    else
+    {
+        heapSiftDown(queue, index);
+    }
+}
+
+/**
+* heapInsert: Moves a node which was put at the end of the heap up to its place.
+*
+* @param queue - Target priority queue.
+* @param node - The node to insert.
+*/
+static void heapInsert(PriorityQueue queue, Node node)
+{
+    heapSiftUp(queue, node->index);
+}
+
+/**
+* heapRemove: Removes a node from the heap, by moving the last node of the heap to its place.
+*
+* @param queue - Target priority queue.
+* @param node - The node to remove.
+*/
+static void heapRemove(PriorityQueue queue, Node node)
+{
+    int index = node->index;
+    nodesRemove(queue, node);
+    if(index != queue->size)
+    {
+        heapFix(queue, index);
+    }
+}
+
+/**
+* heapUpdate: Moves a node up or down the heap after its priority or order was changed.
+*
+* @param queue - Target priority queue.
+* @param node - The node to move.
+*/
+static void heapUpdate(PriorityQueue queue, Node node)
+{
+    heapFix(queue, node->index);
+}
+
+/**
+* heapBuild: Arranges the nodes array as a heap in O(n), by moving down
+*           every node which has children, starting from the last one.
+*
+* @param queue - Target priority queue.
+*/
+static void heapBuild(PriorityQueue queue)
+{
+    if(queue->size < 2)
+    {
+        return;
+    }
+    for(int i = (queue->size - 2) / queue->arity; i >= 0; i--)
+    {
+        heapSiftDown(queue, i);
+    }
+}
+
+/**
+* heapFirst: Returns the first node of the heap, which is its root.
+*
+* @param queue - Target priority queue.
+* @return
+* 	The first node.
+*/
+static Node heapFirst(PriorityQueue queue)
+{
+    return queue->nodes[0];
+}
+
+/**
+* heapPeek: Fills an array with the first k nodes of the heap in order, in O(k log k) for a binary heap.
+*           The candidates for the next node are the children of the nodes taken so far, so they are
+*           kept in a small heap of their own, and the heap of the queue is not changed.
+*
+* @param queue - Target priority queue, with at least k nodes.
+* @param nodes - The array to fill.
+* @param k - The number of nodes to fill.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool heapPeek(PriorityQueue queue, Node* nodes, int k)
+{
+    if(k == 0)
+    {
+        return true;
+    }
+    Node* candidates = malloc(((k - 1) * (queue->arity - 1) + 1) * sizeof(*candidates));
+    if(!candidates)
+    {
+        return false;
+    }
+    int count = 0;
+    candidatesPush(queue, candidates, &count, queue->nodes[0]);
+    for(int i = 0; i < k; i++)
+    {
+        nodes[i] = candidatesPop(queue, candidates, &count);
+        int child = queue->arity * nodes[i]->index + 1;
+        for(int last = child + queue->arity; i + 1 < k && child < last && child < queue->size; child++)
+        {
+            candidatesPush(queue, candidates, &count, queue->nodes[child]);
+        }
+    }
+    free(candidates);
+    return true;
+}
+
+/**
+* calendarDay: Returns the key of a node as an unsigned day, so that earlier days come first in the queue.
+*
+* @param queue - The priority queue which holds the node, with int64 keys.
+* @param node - Target node.
+* @return
+* 	The day of the node.
+*/
+static uint64_t calendarDay(PriorityQueue queue, Node node)
+{
+    int64_t key = *(int64_t*)node->priority;
+    uint64_t day = (uint64_t)(queue->lowest_first ? key : ~key);
+    return day ^ ((uint64_t)1 << 63);
+}
+
+/**
+* calendarBucket: Returns the bucket which a day belongs to.
+*
+* @param calendar - Target calendar.
+* @param day - The day.
+* @return
+* 	The index of the bucket.
+*/
+static int calendarBucket(Calendar calendar, uint64_t day)
+{
+    return (int)((day / calendar->width) & (uint64_t)(calendar->bucket_count - 1));
+}
+
+/**
+* calendarPlace: Links a node into the sorted list of its bucket. Since nodes are usually inserted
+*           after the nodes with the same key, the list is searched from its end.
+*
+* @param queue - Target priority queue.
+* @param node - The node to link.
+*/
+static void calendarPlace(PriorityQueue queue, Node node)
+{
+    Calendar calendar = queue->calendar;
+    Links links = nodeLinks(node);
+    links->bucket = calendarBucket(calendar, calendarDay(queue, node));
+    Node head = calendar->buckets[links->bucket];
+    if(!head)
+    {
+        links->next = node;
+        links->previous = node;
+        calendar->buckets[links->bucket] = node;
+        return;
+    }
+    Node tail = nodeLinks(head)->previous;
+    Node after = tail;
+    while(after != head && nodeIsBefore(queue, node, after))
+    {
+        after = nodeLinks(after)->previous;
+    }
+    if(after == head && nodeIsBefore(queue, node, head))
+    {
+        after = tail;
+        calendar->buckets[links->bucket] = node;
+    }
+    links->previous = after;
+    links->next = nodeLinks(after)->next;
+    nodeLinks(links->next)->previous = node;
+    nodeLinks(after)->next = node;
+}
+
+/**
+* calendarUnlink: Unlinks a node from the list of its bucket.
+*
+* @param queue - Target priority queue.
+* @param node - The node to unlink.
+*/
+static void calendarUnlink(PriorityQueue queue, Node node)
+{
+    Calendar calendar = queue->calendar;
+    Links links = nodeLinks(node);
+    if(links->next == node)
+    {
+        calendar->buckets[links->bucket] = NULL;
+    }
+    else
+    {
+        nodeLinks(links->previous)->next = links->next;
+        nodeLinks(links->next)->previous = links->previous;
+        if(calendar->buckets[links->bucket] == node)
+        {
+            calendar->buckets[links->bucket] = links->next;
+        }
+    }
+    if(calendar->first == node)
+    {
+        calendar->first = NULL;
+    }
+}
+
+/**
+* calendarMoveTo: Moves the start of the search for the first node to the year and bucket of a node.
+*
+* @param queue - Target priority queue.
+* @param node - The node to start from.
+*/
+static void calendarMoveTo(PriorityQueue queue, Node node)
+{
+    Calendar calendar = queue->calendar;
+    uint64_t day = calendarDay(queue, node);
+    calendar->current = nodeLinks(node)->bucket;
+    calendar->start = day - day % calendar->width;
+}
+
+/**
+* calendarRebuild: Links all the nodes of the queue into a given number of buckets, with a width which
+*           fits the current keys. If allocating the buckets fails, the current buckets are kept, and
+*           resizing them is put off until the queue doubles or halves its current size.
+*
+* @param queue - Target priority queue.
+* @param bucket_count - The number of buckets, a power of 2.
+*/
+static void calendarRebuild(PriorityQueue queue, int bucket_count)
+{
+    Calendar calendar = queue->calendar;
+    Node* buckets = bucket_count == calendar->bucket_count ? NULL : calloc(bucket_count, sizeof(*buckets));
+    if(buckets)
+    {
+        free(calendar->buckets);
+        calendar->buckets = buckets;
+        calendar->bucket_count = bucket_count;
+    }
+    else
+    {
+        for(int i = 0; i < calendar->bucket_count; i++)
+        {
+            calendar->buckets[i] = NULL;
+        }
+    }
+    calendar->grow_size = 2 * calendar->bucket_count;
+    calendar->shrink_size = calendar->bucket_count > CALENDAR_MIN_BUCKETS ? calendar->bucket_count / 2 : 0;
+    if(!buckets && bucket_count != calendar->bucket_count)
+    {
+        calendar->grow_size = 2 * queue->size > calendar->grow_size ? 2 * queue->size : calendar->grow_size;
+        calendar->shrink_size = queue->size / 2 < calendar->shrink_size ? queue->size / 2 : calendar->shrink_size;
+    }
+    Node first = NULL;
+    uint64_t last_day = 0;
+    for(int i = 0; i < queue->size; i++)
+    {
+        Node node = queue->nodes[i];
+        uint64_t day = calendarDay(queue, node);
+        last_day = !first || day > last_day ? day : last_day;
+        first = !first || nodeIsBefore(queue, node, first) ? node : first;
+    }
+    uint64_t separation = queue->size > 0 ? (last_day - calendarDay(queue, first)) / queue->size : 0;
+    calendar->width = separation < UINT64_MAX / CALENDAR_WIDTH_FACTOR ? separation * CALENDAR_WIDTH_FACTOR + 1 : UINT64_MAX;
+    for(int i = 0; i < queue->size; i++)
+    {
+        calendarPlace(queue, queue->nodes[i]);
+    }
+    calendar->first = first;
+    calendar->current = 0;
+    calendar->start = 0;
+    if(first)
+    {
+        calendarMoveTo(queue, first);
+    }
+}
+
+/**
+* calendarCreate: Allocates the calendar of a queue, with the minimal number of buckets.
+*
+* @param queue - Target priority queue.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool calendarCreate(PriorityQueue queue)
+{
+    Calendar calendar = malloc(sizeof(*calendar));
+    if(!calendar)
+    {
+        return false;
+    }
+    calendar->buckets = calloc(CALENDAR_MIN_BUCKETS, sizeof(*calendar->buckets));
+    if(!calendar->buckets)
+    {
+        free(calendar);
+        return false;
+    }
+    calendar->bucket_count = CALENDAR_MIN_BUCKETS;
+    calendar->grow_size = 2 * CALENDAR_MIN_BUCKETS;
+    calendar->shrink_size = 0;
+    calendar->width = 1;
+    calendar->current = 0;
+    calendar->start = 0;
+    calendar->first = NULL;
+    queue->calendar = calendar;
+    return true;
+}
+
+/**
+* calendarDestroy: Deallocates the calendar of a queue.
+*
+* @param queue - Target priority queue.
+*/
+static void calendarDestroy(PriorityQueue queue)
+{
+    free(queue->calendar->buckets);
+    free(queue->calendar);
+    queue->calendar = NULL;
+}
+
+/**
+* calendarLink: Links a node whose key was set, and keeps the start of the search and the first node
+*           up to date.
+*
+* @param queue - Target priority queue.
+* @param node - The node to link.
+*/
+static void calendarLink(PriorityQueue queue, Node node)
+{
+    Calendar calendar = queue->calendar;
+    calendarPlace(queue, node);
+    if(queue->size == 1 || calendarDay(queue, node) < calendar->start)
+    {
+        calendarMoveTo(queue, node);
+    }
+    if(calendar->first && nodeIsBefore(queue, node, calendar->first))
+    {
+        calendar->first = node;
+    }
+}
+
+/**
+* calendarInsert: Inserts a node to the calendar, in O(1) on average. The number of buckets is
+*           doubled when there are more than grow_size nodes, normally twice as many as buckets.
+*
+* @param queue - Target priority queue.
+* @param node - The node to insert.
+*/
+static void calendarInsert(PriorityQueue queue, Node node)
+{
+    if(queue->size > queue->calendar->grow_size)
+    {
+        calendarRebuild(queue, queue->calendar->bucket_count * EXPAND_FACTOR);
+        return;
+    }
+    calendarLink(queue, node);
+}
+
+/**
+* calendarRemove: Removes a node from the calendar and from the nodes array. The number of buckets is
+*           halved when there are less than shrink_size nodes, normally half as many as buckets.
+*
+* @param queue - Target priority queue.
+* @param node - The node to remove.
+*/
+static void calendarRemove(PriorityQueue queue, Node node)
+{
+    calendarUnlink(queue, node);
+    nodesRemove(queue, node);
+    if(queue->size < queue->calendar->shrink_size)
+    {
+        calendarRebuild(queue, queue->calendar->bucket_count / EXPAND_FACTOR);
+    }
+}
+
+/**
+* calendarUpdate: Moves a node to its bucket after its priority or order was changed.
+*
+* @param queue - Target priority queue.
+* @param node - The node to move.
+*/
+static void calendarUpdate(PriorityQueue queue, Node node)
+{
+    calendarUnlink(queue, node);
+    calendarLink(queue, node);
+}
+
+/**
+* calendarBuild: Links all the nodes of the nodes array, with a number of buckets which fits them.
+*
+* @param queue - Target priority queue.
+*/
+static void calendarBuild(PriorityQueue queue)
+{
+    int bucket_count = CALENDAR_MIN_BUCKETS;
+    while(bucket_count < queue->size)
+    {
+        bucket_count *= EXPAND_FACTOR;
+    }
+    calendarRebuild(queue, bucket_count);
+}
+
+/**
+* calendarFirst: Returns the first node of the calendar. The buckets are searched from the current one,
+*           each for a node in the current year, which takes O(1) on average when the keys are taken out
+*           in increasing order. If a whole year is empty, the first node is searched in all the buckets.
+*
+* @param queue - Target priority queue.
+* @return
+* 	The first node.
+*/
+static Node calendarFirst(PriorityQueue queue)
+{
+    Calendar calendar = queue->calendar;
+    if(calendar->first)
+    {
+        return calendar->first;
+    }
+    int bucket = calendar->current;
+    uint64_t start = calendar->start;
+    for(int i = 0; i < calendar->bucket_count; i++)
+    {
+        Node head = calendar->buckets[bucket];
+        if(head && calendarDay(queue, head) - start < calendar->width)
+        {
+            calendar->current = bucket;
+            calendar->start = start;
+            calendar->first = head;
+            return head;
+        }
+        bucket = (bucket + 1) & (calendar->bucket_count - 1);
+        start += calendar->width;
+    }
+    Node first = NULL;
+    for(int i = 0; i < calendar->bucket_count; i++)
+    {
+        Node head = calendar->buckets[i];
+        if(head && (!first || nodeIsBefore(queue, head, first)))
+        {
+            first = head;
+        }
+    }
+    calendarMoveTo(queue, first);
+    calendar->first = first;
+    return first;
+}
+
+/**
+* pairingMeld: Melds two pairing heaps, by making the root which comes later the first child of the other root.
+*
+* @param queue - Target priority queue.
+* @param root1 - The root of the first heap, which has no siblings.
+* @param root2 - The root of the second heap, which has no siblings.
+* @return
+* 	The root of the melded heap.
+*/
+static Node pairingMeld(PriorityQueue queue, Node root1, Node root2)
+{
+    if(nodeIsBefore(queue, root2, root1))
+    {
+        Node temp = root1;
+        root1 = root2;
+        root2 = temp;
+    }
+    Links parent = nodeLinks(root1);
+    Links child = nodeLinks(root2);
+    child->next = parent->child;
+    if(parent->child)
+    {
+        nodeLinks(parent->child)->previous = root2;
+    }
+    child->previous = root1;
+    parent->child = root2;
+    return root1;
+}
+
+/**
+* pairingMergePairs: Melds a list of sibling heaps into one heap in two passes - the siblings are melded
+*           in pairs from the first one, and then the pairs are melded from the last one.
+*
+* @param queue - Target priority queue.
+* @param first - The first sibling, or NULL.
+* @return
+* 	The root of the melded heap, or NULL if there were no siblings.
+*/
+static Node pairingMergePairs(PriorityQueue queue, Node first)
+{
+    Node pairs = NULL;
+    while(first)
+    {
+        Node pair = first;
+        Node second = nodeLinks(pair)->next;
+        first = second ? nodeLinks(second)->next : NULL;
+        nodeLinks(pair)->previous = NULL;
+        if(second)
+        {
+            nodeLinks(second)->next = NULL;
+            nodeLinks(second)->previous = NULL;
+            nodeLinks(pair)->next = NULL;
+            pair = pairingMeld(queue, pair, second);
+        }
+        nodeLinks(pair)->next = pairs;
+        pairs = pair;
+    }
+    Node root = pairs;
+    while(pairs)
+    {
+        pairs = nodeLinks(root)->next;
+        nodeLinks(root)->next = NULL;
+        if(pairs)
+        {
+            Node next = nodeLinks(pairs)->next;
+            nodeLinks(pairs)->next = NULL;
+            root = pairingMeld(queue, root, pairs);
+            nodeLinks(root)->next = next;
+        }
+    }
+    return root;
+}
+
+/**
+* pairingDetach: Detaches a node from the pairing heap, and melds its children back into the heap.
+*
+* @param queue - Target priority queue.
+* @param node - The node to detach.
+*/
+static void pairingDetach(PriorityQueue queue, Node node)
+{
+    Links links = nodeLinks(node);
+    if(node != queue->root)
+    {
+        Links previous = nodeLinks(links->previous);
+        if(previous->child == node)
+        {
+            previous->child = links->next;
+        }
+        else
+        {
+            previous->next = links->next;
+        }
+        if(links->next)
+        {
+            nodeLinks(links->next)->previous = links->previous;
+        }
+    }
+    Node children = pairingMergePairs(queue, links->child);
+    links->next = NULL;
+    links->previous = NULL;
+    links->child = NULL;
+    if(node == queue->root)
+    {
+        queue->root = children;
+    }
+    else if(children)
+    {
+        queue->root = pairingMeld(queue, queue->root, children);
+    }
+}
+
+/**
+* pairingInsert: Inserts a node to the pairing heap in O(1), by melding it with the root.
+*
+* @param queue - Target priority queue.
+* @param node - The node to insert.
+*/
+static void pairingInsert(PriorityQueue queue, Node node)
+{
+    Links links = nodeLinks(node);
+    links->next = NULL;
+    links->previous = NULL;
+    links->child = NULL;
+    queue->root = queue->root ? pairingMeld(queue, queue->root, node) : node;
+}
+
+/**
+* pairingRemove: Removes a node from the pairing heap and from the nodes array, in O(log n) amortized.
+*
+* @param queue - Target priority queue.
+* @param node - The node to remove.
+*/
+static void pairingRemove(PriorityQueue queue, Node node)
+{
+    pairingDetach(queue, node);
+    nodesRemove(queue, node);
+}
+
+/**
+* pairingUpdate: Moves a node after its priority or order was changed, by detaching it and inserting it again.
+*
+* @param queue - Target priority queue.
+* @param node - The node to move.
+*/
+static void pairingUpdate(PriorityQueue queue, Node node)
+{
+    pairingDetach(queue, node);
+    pairingInsert(queue, node);
+}
+
+/**
+* pairingBuild: Builds the pairing heap from all the nodes of the nodes array, in O(n).
+*
+* @param queue - Target priority queue.
+*/
+static void pairingBuild(PriorityQueue queue)
+{
+    queue->root = NULL;
+    for(int i = 0; i < queue->size; i++)
+    {
+        pairingInsert(queue, queue->nodes[i]);
+    }
+}
+
+/**
+* pairingFirst: Returns the first node of the pairing heap, which is its root.
+*
+* @param queue - Target priority queue.
+* @return
+* 	The first node.
+*/
+static Node pairingFirst(PriorityQueue queue)
+{
+    return queue->root;
+}
+
+/**
+* randomNext: Advances a xorshift random state.
+*
+* @param state - The random state, which is never 0.
+* @return
+* 	The next random number.
+*/
+static uint64_t randomNext(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+* skipListReset: Makes the skip list empty, and releases all its index entries at once.
+*
+* @param skip_list - Target skip list.
+*/
+static void skipListReset(SkipList skip_list)
+{
+    poolRelease(skip_list->index_pool);
+    skip_list->first = NULL;
+    skip_list->levels = 1;
+    for(int level = 1; level < SKIP_LIST_LEVELS; level++)
+    {
+        skip_list->heads[level].node = NULL;
+        skip_list->heads[level].right = NULL;
+        skip_list->heads[level].down = level > 1 ? &skip_list->heads[level - 1] : NULL;
+    }
+}
+
+/**
+* skipListHeight: Chooses the number of levels of a new node, including the list of nodes.
+*           A node reaches every level with half the chance of the level below it.
+*
+* @param skip_list - Target skip list.
+* @return
+* 	The number of levels, between 1 and SKIP_LIST_LEVELS - 1.
+*/
+static int skipListHeight(SkipList skip_list)
+{
+    int height = 1;
+    for(uint64_t bits = randomNext(&skip_list->random); (bits & 1) && height < SKIP_LIST_LEVELS - 1; bits >>= 1)
+    {
+        height++;
+    }
+    return height;
+}
+
+/**
+* skipListSeek: Finds, in every level, the last entry whose node comes before a given position.
+*
+* @param queue - Target priority queue.
+* @param node - If not NULL, the position is right before node in the order of the queue.
+* @param priority - If node is NULL, the position is right before the first node with priority,
+*           or with a priority which comes after it.
+* @param update - Array to fill with the last entry before the position in every level above the list of
+*           nodes, or NULL.
+* @return
+* 	The last node before the position in the list of nodes, or NULL if the position is at its start.
+*/
+static Node skipListSeek(PriorityQueue queue, Node node, PQElementPriority priority, SkipIndex* update)
+{
+    SkipList skip_list = queue->skip_list;
+    int top = skip_list->levels - 1;
+    for(int level = top + 1; update && level < SKIP_LIST_LEVELS; level++)
+    {
+        update[level] = &skip_list->heads[level];
+    }
+    SkipIndex entry = top > 0 ? &skip_list->heads[top] : NULL;
+    for(int level = top; level > 0; level--)
+    {
+        while(entry->right && (node ? nodeIsBefore(queue, entry->right->node, node) :
+                               keyCompare(queue, entry->right->node->priority, priority) > 0))
+        {
+            entry = entry->right;
+        }
+        if(update)
+        {
+            update[level] = entry;
+        }
+        if(level > 1)
+        {
+            entry = entry->down;
+        }
+    }
+    Node previous = entry ? entry->node : NULL;
+    Node next = previous ? nodeLinks(previous)->next : skip_list->first;
+    while(next && (node ? nodeIsBefore(queue, next, node) : keyCompare(queue, next->priority, priority) > 0))
+    {
+        previous = next;
+        next = nodeLinks(next)->next;
+    }
+    return previous;
+}
+
+/**
+* skipListLink: Links a node into the skip list, with index entries in a random number of levels.
+*           If an index entry cannot be allocated, the node gets fewer levels.
+*
+* @param queue - Target priority queue.
+* @param node - The node to link.
+*/
+static void skipListLink(PriorityQueue queue, Node node)
+{
+    SkipList skip_list = queue->skip_list;
+    SkipIndex update[SKIP_LIST_LEVELS];
+    Node previous = skipListSeek(queue, node, NULL, update);
+    Links links = nodeLinks(node);
+    links->previous = previous;
+    links->next = previous ? nodeLinks(previous)->next : skip_list->first;
+    if(links->next)
+    {
+        nodeLinks(links->next)->previous = node;
+    }
+    if(previous)
+    {
+        nodeLinks(previous)->next = node;
+    }
+    else
+    {
+        skip_list->first = node;
+    }
+    int height = skipListHeight(skip_list);
+    SkipIndex down = NULL;
+    for(int level = 1; level < height; level++)
+    {
+        SkipIndex entry = (SkipIndex)poolAllocate(skip_list->index_pool);
+        if(!entry)
+        {
+            break;
+        }
+        entry->node = node;
+        entry->down = down;
+        entry->right = update[level]->right;
+        update[level]->right = entry;
+        down = entry;
+        if(level >= skip_list->levels)
+        {
+            skip_list->levels = level + 1;
+        }
+    }
+}
+
+/**
+* skipListUnlink: Unlinks a node from the skip list, and frees its index entries.
+*           The priority of the node may already be changed, so its entries are found by the
+*           node before it, which is still in its place.
+*
+* @param queue - Target priority queue.
+* @param node - The node to unlink.
+*/
+static void skipListUnlink(PriorityQueue queue, Node node)
+{
+    SkipList skip_list = queue->skip_list;
+    Links links = nodeLinks(node);
+    SkipIndex entry = &skip_list->heads[skip_list->levels - 1];
+    for(int level = skip_list->levels - 1; level > 0; level--)
+    {
+        while(links->previous && entry->right && entry->right->node != node &&
+              (entry->right->node == links->previous || nodeIsBefore(queue, entry->right->node, links->previous)))
+        {
+            entry = entry->right;
+        }
+        SkipIndex to_delete = entry->right;
+        if(to_delete && to_delete->node == node)
+        {
+            entry->right = to_delete->right;
+            poolFree(skip_list->index_pool, (Node)to_delete);
+        }
+        entry = entry->down;
+    }
+    if(links->previous)
+    {
+        nodeLinks(links->previous)->next = links->next;
+    }
+    else
+    {
+        skip_list->first = links->next;
+    }
+    if(links->next)
+    {
+        nodeLinks(links->next)->previous = links->previous;
+    }
+}
+
+/**
+* skipListCreate: Allocates an empty skip list for the queue.
+*
+* @param queue - Target priority queue.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool skipListCreate(PriorityQueue queue)
+{
+    SkipList skip_list = malloc(sizeof(*skip_list));
+    if(!skip_list)
+    {
+        return false;
+    }
+    skip_list->index_pool = pqNodePoolCreate();
+    if(!skip_list->index_pool)
+    {
+        free(skip_list);
+        return false;
+    }
+    skip_list->index_pool->node_units = (sizeof(struct PQSkipIndex_t) + sizeof(Unit) - 1) / sizeof(Unit);
+    skip_list->random = SKIP_LIST_SEED;
+    skipListReset(skip_list);
+    queue->skip_list = skip_list;
+    return true;
+}
+
+/**
+* skipListDestroy: Deallocates the skip list of the queue.
+*
+* @param queue - Target priority queue.
+*/
+static void skipListDestroy(PriorityQueue queue)
+{
+    pqNodePoolDestroy(queue->skip_list->index_pool);
+    free(queue->skip_list);
+    queue->skip_list = NULL;
+}
+
+/**
+* skipListInsert: Inserts a node to the skip list, in O(log n) on average.
+*
+* @param queue - Target priority queue.
+* @param node - The node to insert.
+*/
+static void skipListInsert(PriorityQueue queue, Node node)
+{
+    skipListLink(queue, node);
+}
+
+/**
+* skipListRemove: Removes a node from the skip list and from the nodes array, in O(log n) on average.
+*
+* @param queue - Target priority queue.
+* @param node - The node to remove.
+*/
+static void skipListRemove(PriorityQueue queue, Node node)
+{
+    skipListUnlink(queue, node);
+    nodesRemove(queue, node);
+}
+
+/**
+* skipListUpdate: Moves a node after its priority or order was changed, by unlinking it and linking it again.
+*
+* @param queue - Target priority queue.
+* @param node - The node to move.
+*/
+static void skipListUpdate(PriorityQueue queue, Node node)
+{
+    skipListUnlink(queue, node);
+    skipListLink(queue, node);
+}
+
+/**
+* skipListBuild: Builds the skip list from all the nodes of the nodes array, in O(n log n).
+*
+* @param queue - Target priority queue.
+*/
+static void skipListBuild(PriorityQueue queue)
+{
+    skipListReset(queue->skip_list);
+    for(int i = 0; i < queue->size; i++)
+    {
+        skipListLink(queue, queue->nodes[i]);
+    }
+}
+
+/**
+* skipListFirst: Returns the first node of the skip list.
+*
+* @param queue - Target priority queue.
+* @return
+* 	The first node.
+*/
+static Node skipListFirst(PriorityQueue queue)
+{
+    return queue->skip_list->first;
+}
+
+/**
+* skipListPeek: Fills an array with the first k nodes of the skip list, in O(k).
+*
+* @param queue - Target priority queue, with at least k nodes.
+* @param nodes - The array to fill.
+* @param k - The number of nodes to fill.
+* @return
+* 	true.
+*/
+static bool skipListPeek(PriorityQueue queue, Node* nodes, int k)
+{
+    Node node = queue->skip_list->first;
+    for(int i = 0; i < k; i++, node = nodeLinks(node)->next)
+    {
+        nodes[i] = node;
+    }
+    return true;
+}
+
+/**
+* sortedCreate: Allocates the key array of a queue with PQ_KEY_INT64 keys, with room for the capacity of
+*           its nodes array. Queues with other keys have no key array.
+*
+* @param queue - Target priority queue.
+* @return
+* 	false if the allocation failed.
+* 	Otherwise true.
+*/
+static bool sortedCreate(PriorityQueue queue)
+{
+    if(queue->key_type != PQ_KEY_INT64)
+    {
+        return true;
+    }
+    KeyArray key_array = malloc(sizeof(*key_array));
+    if(!key_array)
+    {
+        return false;
+    }
+    key_array->keys = NULL;
+    key_array->block = NULL;
+    key_array->capacity = 0;
+    if(!keyArrayReserve(key_array, queue->capacity, 0))
+    {
+        free(key_array);
+        return false;
+    }
+    queue->key_array = key_array;
+    return true;
+}
+
+/**
+* sortedDestroy: Deallocates the key array of a queue, if it has one.
+*
+* @param queue - Target priority queue.
+*/
+static void sortedDestroy(PriorityQueue queue)
+{
+    if(queue->key_array)
+    {
+        free(queue->key_array->block);
+        free(queue->key_array);
+    }
+    queue->key_array = NULL;
+}
+
+/**
+* sortedFixKeys: sortedFix, for a queue with a key array. The place of the node is found by searching
+*           the keys without it, and only nodes with the same key are read, to compare their order.
+*
+* @param queue - Target priority queue.
+* @param node - The node to move.
+*/
+static void sortedFixKeys(PriorityQueue queue, Node node)
+{
+    int64_t* keys = queue->key_array->keys;
+    int64_t key = keyArrayKey(queue, node->priority);
+    int index = node->index;
+    int last = queue->size - 1;
+    memmove(keys + index, keys + index + 1, (last - index) * sizeof(*keys));
+    int place = keyArrayRank(queue->key_array, last, key, true);
+    while(place > 0 && keys[place - 1] == key &&
+          node->order < queue->nodes[place - 1 < index ? place - 1 : place]->order)
+    {
+        place--;
+    }
+    memmove(keys + place + 1, keys + place, (last - place) * sizeof(*keys));
+    keys[place] = key;
+    for(int i = index; i < place; i++)
+    {
+        nodePlace(queue, queue->nodes[i + 1], i);
+    }
+    for(int i = index; i > place; i--)
+    {
+        nodePlace(queue, queue->nodes[i - 1], i);
+    }
+    nodePlace(queue, node, place);
+}
+
+/**
+* sortedFix: Moves a node along the sorted array to its place, after it was put at the end of the array,
+*           or after its priority or order was changed. Takes O(n).
+*
+* @param queue - Target priority queue.
+* @param node - The node to move.
+*/
+static void sortedFix(PriorityQueue queue, Node node)
+{
+    if(queue->key_array)
+    {
+        sortedFixKeys(queue, node);
+        return;
+    }
+    int index = node->index;
+    while(index + 1 < queue->size && nodeIsBefore(queue, queue->nodes[index + 1], node))
+    {
+        nodePlace(queue, queue->nodes[index + 1], index);
+        index++;
+    }
+    while(index > 0 && nodeIsBefore(queue, node, queue->nodes[index - 1]))
+    {
+        nodePlace(queue, queue->nodes[index - 1], index);
+        index--;
+    }
+    nodePlace(queue, node, index);
+}
+
+/**
+* sortedRemove: Removes a node from the sorted array, by moving the nodes after it back. Takes O(n).
+*
+* @param queue - Target priority queue.
+* @param node - The node to remove.
+*/
+static void sortedRemove(PriorityQueue queue, Node node)
+{
+    queue->size--;
+    if(queue->key_array)
+    {
+        int64_t* keys = queue->key_array->keys;
+        memmove(keys + node->index, keys + node->index + 1, (queue->size - node->index) * sizeof(*keys));
+    }
+    for(int i = node->index; i < queue->size; i++)
+    {
+        nodePlace(queue, queue->nodes[i + 1], i);
+    }
+}
+
+/**
+* sortedBuild: Sorts the nodes array in O(n log n). If the allocation for the merge sort fails,
+*           the array is sorted by insertion instead. The key array is filled from the sorted nodes.
+*
+* @param queue - Target priority queue.
+*/
+static void sortedBuild(PriorityQueue queue)
+{
+    KeyArray key_array = queue->key_array;
+    queue->key_array = NULL;
+    if(!nodesSort(queue, queue->nodes, queue->size))
+    {
+        for(int i = 0; i < queue->size; i++)
+        {
+            sortedFix(queue, queue->nodes[i]);
+        }
+    }
+    queue->key_array = key_array;
+    for(int i = 0; i < queue->size; i++)
+    {
+        queue->nodes[i]->index = i;
+        if(key_array)
+        {
+            key_array->keys[i] = keyArrayKey(queue, queue->nodes[i]->priority);
+        }
+    }
+}
+
+/**
+* sortedBuildFrom: Sorts the nodes put at the end of the sorted array from index first onwards, and merges
+*           them with the sorted nodes before them, in O(n + m log m) for m new nodes. If the allocation
+*           for the merge fails, the whole array is sorted by sortedBuild instead.
+*
+* @param queue - Target priority queue, whose nodes before first are sorted.
+* @param first - The index of the first new node.
+*/
+static void sortedBuildFrom(PriorityQueue queue, int first)
+{
+    Node* temp = malloc(queue->size * sizeof(*temp));
+    if(!temp)
+    {
+        sortedBuild(queue);
+        return;
+    }
+    nodesMergeSort(queue, queue->nodes + first, temp, queue->size - first);
+    nodesMerge(queue, queue->nodes, temp, first, queue->size);
+    free(temp);
+    for(int i = 0; i < queue->size; i++)
+    {
+        queue->nodes[i]->index = i;
+        if(queue->key_array)
+        {
+            queue->key_array->keys[i] = keyArrayKey(queue, queue->nodes[i]->priority);
+        }
+    }
+}
+
+/**
+* sortedPeek: Fills an array with the first k nodes of the sorted array, in O(k).
+*
+* @param queue - Target priority queue, with at least k nodes.
+* @param nodes - The array to fill.
+* @param k - The number of nodes to fill.
+* @return
+* 	true.
+*/
+static bool sortedPeek(PriorityQueue queue, Node* nodes, int k)
+{
+    for(int i = 0; i < k; i++)
+    {
+        nodes[i] = queue->nodes[i];
+    }
+    return true;
+}
+
+/** The backends, by PQBackendType */
+static const struct PQBackend_t backends[] = {
+    {false, false, true, NULL, NULL, heapInsert, heapRemove, heapUpdate, heapBuild, heapFirst, heapPeek},
+    {true, false, false, calendarCreate, calendarDestroy, calendarInsert, calendarRemove, calendarUpdate,
+     calendarBuild, calendarFirst, nodesSelect},
+    {false, false, true, NULL, NULL, heapInsert, heapRemove, heapUpdate, heapBuild, heapFirst, heapPeek},
+    {true, false, false, NULL, NULL, pairingInsert, pairingRemove, pairingUpdate, pairingBuild, pairingFirst,
+     nodesSelect},
+    {false, true, true, sortedCreate, sortedDestroy, sortedFix, sortedRemove, sortedFix, sortedBuild, heapFirst,
+     sortedPeek},
+    {true, false, false, skipListCreate, skipListDestroy, skipListInsert, skipListRemove, skipListUpdate,
+     skipListBuild, skipListFirst, skipListPeek}
+};
+
+/**
+* versionEntryCreate: Allocates a new entry of the versions of the queue, which is not in any version yet.
+*
+* @param queue - Target persistent queue.
+* @param element - The element of the entry.
+* @param priority - The priority of the entry. An inline key is copied into the entry.
+* @param order - The order of the entry.
+* @return
+* 	NULL - if the allocation failed.
+* 	A new entry with a single reference in case of success.
+*/
+static VersionEntry versionEntryCreate(PriorityQueue queue, PQElement element, PQElementPriority priority,
+                                       unsigned long order)
+{
+    VersionEntry entry = (VersionEntry)poolAllocate(queue->versions->entry_pool);
+    if(!entry)
+    {
+        return NULL;
+    }
+    entry->element = element;
+    entry->priority = priority;
+    if(keyIsInline(queue))
+    {
+        memcpy(entry->key, priority, queue->key_size);
+        entry->priority = entry->key;
+    }
+    entry->order = order;
+    entry->weight = (uint32_t)(randomNext(&queue->versions->random) >> 32);
+    entry->ref_count = 1;
+    entry->left = NULL;
+    entry->right = NULL;
+    return entry;
+}
+
+/**
+* versionEntryCopy: Allocates a copy of an entry, which refers to the same children.
+*
+* @param queue - Target persistent queue.
+* @param entry - The entry to copy.
+* @return
+* 	NULL - if the allocation failed.
+* 	A new entry with a single reference in case of success.
+*/
+static VersionEntry versionEntryCopy(PriorityQueue queue, VersionEntry entry)
+{
+    VersionEntry copy = (VersionEntry)poolAllocate(queue->versions->entry_pool);
+    if(!copy)
+    {
+        return NULL;
+    }
+    *copy = *entry;
+    if(keyIsInline(queue))
+    {
+        memcpy(copy->key, entry->key, queue->key_size);
+        copy->priority = copy->key;
+    }
+    copy->ref_count = 1;
+    if(copy->left)
+    {
+        copy->left->ref_count++;
+    }
+    if(copy->right)
+    {
+        copy->right->ref_count++;
+    }
+    return copy;
+}
+
+/**
+* versionEntryRelease: Drops a reference to an entry, and frees it along with the entries only it refers to
+*           once it has no references left.
+*
+* @param queue - Target persistent queue.
+* @param entry - The entry to release, or NULL.
+*/
+static void versionEntryRelease(PriorityQueue queue, VersionEntry entry)
+{
+    while(entry && --entry->ref_count == 0)
+    {
+        VersionEntry right = entry->right;
+        versionEntryRelease(queue, entry->left);
+        poolFree(queue->versions->entry_pool, (Node)entry);
+        entry = right;
+    }
+}
+
+/**
+* versionCompare: Compares the position of an entry with a position in the order of the queue.
+*
+* @param queue - Target persistent queue.
+* @param entry - The entry to compare.
+* @param priority - The priority of the position.
+* @param order - The order of the position.
+* @return
+* 	A negative integer if the entry comes before the position, 0 if it is at the position,
+* 	and a positive integer otherwise.
+*/
+static int versionCompare(PriorityQueue queue, VersionEntry entry, PQElementPriority priority, unsigned long order)
+{
+    int result = keyCompare(queue, priority, entry->priority);
+    if(result == 0)
+    {
+        result = (entry->order > order) - (entry->order < order);
+    }
+    return result;
+}
+
+/**
+* versionSplit: Splits a version into the entries which come before a position and the entries after it.
+*           The given version is not changed.
+*
+* @param queue - Target persistent queue.
+* @param tree - The version to split, or NULL.
+* @param priority - The priority of the position.
+* @param order - The order of the position.
+* @param before - Pointer to assign the version of the entries before the position into.
+* @param after - Pointer to assign the version of the other entries into.
+* @return
+* 	false if an allocation failed, nothing is assigned.
+* 	Otherwise true, and the caller holds a reference to both new versions.
+*/
+static bool versionSplit(PriorityQueue queue, VersionEntry tree, PQElementPriority priority, unsigned long order,
+                         VersionEntry* before, VersionEntry* after)
+{
+    if(!tree)
+    {
+        *before = NULL;
+        *after = NULL;
+        return true;
+    }
+    VersionEntry copy = versionEntryCopy(queue, tree);
+    if(!copy)
+    {
+        return false;
+    }
+    VersionEntry left = NULL;
+    VersionEntry right = NULL;
+    if(versionCompare(queue, tree, priority, order) < 0)
+    {
+        if(!versionSplit(queue, tree->right, priority, order, &left, &right))
+        {
+            versionEntryRelease(queue, copy);
+            return false;
+        }
+        versionEntryRelease(queue, copy->right);
+        copy->right = left;
+        *before = copy;
+        *after = right;
+    }
+    else
+    {
+        if(!versionSplit(queue, tree->left, priority, order, &left, &right))
+        {
+            versionEntryRelease(queue, copy);
+            return false;
+        }
+        versionEntryRelease(queue, copy->left);
+        copy->left = right;
+        *before = left;
+        *after = copy;
+    }
+    return true;
+}
+
+/**
+* versionInsert: Creates a new version with one more entry. The given version is not changed.
+*
+* @param queue - Target persistent queue.
+* @param tree - The version to insert into, or NULL.
+* @param entry - A new entry, which is not in any version yet.
+* @return
+* 	NULL - if an allocation failed.
+* 	The new version in case of success, which the caller holds a reference to.
+*/
+static VersionEntry versionInsert(PriorityQueue queue, VersionEntry tree, VersionEntry entry)
+{
+    if(!tree || entry->weight > tree->weight)
+    {
+        if(!versionSplit(queue, tree, entry->priority, entry->order, &entry->left, &entry->right))
+        {
+            return NULL;
+        }
+        entry->ref_count++;
+        return entry;
+    }
+    VersionEntry copy = versionEntryCopy(queue, tree);
+    if(!copy)
+    {
+        return NULL;
+    }
+    VersionEntry* child = versionCompare(queue, tree, entry->priority, entry->order) < 0 ? &copy->right : &copy->left;
+    VersionEntry inserted = versionInsert(queue, *child, entry);
+    if(!inserted)
+    {
+        versionEntryRelease(queue, copy);
+        return NULL;
+    }
+    versionEntryRelease(queue, *child);
+    *child = inserted;
+    return copy;
+}
+
+/**
+* versionJoin: Creates a version of the entries of two versions, all the entries of the first coming
+*           before all the entries of the second. The given versions are not changed.
+*
+* @param queue - Target persistent queue.
+* @param before - The first version, or NULL.
+* @param after - The second version, or NULL.
+* @param result - Pointer to assign the new version into.
+* @return
+* 	false if an allocation failed, nothing is assigned.
+* 	Otherwise true, and the caller holds a reference to the new version.
+*/
+static bool versionJoin(PriorityQueue queue, VersionEntry before, VersionEntry after, VersionEntry* result)
+{
+    if(!before || !after)
+    {
+        *result = before ? before : after;
+        if(*result)
+        {
+            (*result)->ref_count++;
+        }
+        return true;
+    }
+    bool before_on_top = before->weight > after->weight;
+    VersionEntry copy = versionEntryCopy(queue, before_on_top ? before : after);
+    VersionEntry joined = NULL;
+    if(!copy || !versionJoin(queue, before_on_top ? before->right : before, before_on_top ? after : after->left,
+                             &joined))
+    {
+        versionEntryRelease(queue, copy);
+        return false;
+    }
+    VersionEntry* child = before_on_top ? &copy->right : &copy->left;
+    versionEntryRelease(queue, *child);
+    *child = joined;
+    *result = copy;
+    return true;
+}
+
+/**
+* versionRemove: Creates a new version without the entry at a given position. The given version is not changed.
+*
+* @param queue - Target persistent queue.
+* @param tree - The version to remove from, which has an entry at the position.
+* @param priority - The priority of the entry to remove.
+* @param order - The order of the entry to remove.
+* @param result - Pointer to assign the new version into.
+* @return
+* 	false if an allocation failed, nothing is assigned.
+* 	Otherwise true, and the caller holds a reference to the new version.
+*/
+static bool versionRemove(PriorityQueue queue, VersionEntry tree, PQElementPriority priority, unsigned long order,
+                          VersionEntry* result)
+{
+    int compare = versionCompare(queue, tree, priority, order);
+    if(compare == 0)
+    {
+        return versionJoin(queue, tree->left, tree->right, result);
+    }
+    VersionEntry copy = versionEntryCopy(queue, tree);
+    VersionEntry removed = NULL;
+    if(!copy || !versionRemove(queue, compare < 0 ? tree->right : tree->left, priority, order, &removed))
+    {
+        versionEntryRelease(queue, copy);
+        return false;
+    }
+    VersionEntry* child = compare < 0 ? &copy->right : &copy->left;
+    versionEntryRelease(queue, *child);
+    *child = removed;
+    *result = copy;
+    return true;
+}
+
+/**
+* versionForEach: Calls a function for every entry of a version, in the order of the queue.
+*
+* @param tree - The version, or NULL.
+* @param callback - The function to call for every element, with its priority and context.
+* @param context - Passed to callback as is.
+*/
+static void versionForEach(VersionEntry tree, PQElementCallback callback, void* context)
+{
+    while(tree)
+    {
+        versionForEach(tree->left, callback, context);
+        callback(tree->element, tree->priority, context);
+        tree = tree->right;
+    }
+}
+
+/**
+* queueIsPinned: Checks if the queue has snapshots, which may still see the elements and priorities removed from it.
+*
+* @param queue - Target priority queue.
+* @return
+* 	true if the queue is persistent and has snapshots which were not released.
+* 	Otherwise false.
+*/
+static bool queueIsPinned(PriorityQueue queue)
+{
+    return queue->versions && queue->versions->oldest;
+}
+
+/**
+* versionsCreate: Makes the queue persistent, with an empty current version. The queue must be empty.
+*
+* @param queue - Target priority queue.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool versionsCreate(PriorityQueue queue)
+{
+    Versions versions = malloc(sizeof(*versions));
+    if(!versions)
+    {
+        return false;
+    }
+    versions->entry_pool = pqNodePoolCreate();
+    if(!versions->entry_pool)
+    {
+        free(versions);
+        return false;
+    }
+    versions->entry_pool->node_units = (sizeof(struct PQVersionEntry_t) + queue->key_size + sizeof(Unit) - 1) /
+                                       sizeof(Unit);
+    versions->root = NULL;
+    versions->random = VERSIONS_SEED;
+    versions->sequence = 0;
+    versions->oldest = NULL;
+    versions->newest = NULL;
+    versions->retired = NULL;
+    versions->retired_count = 0;
+    versions->retired_capacity = 0;
+    queue->versions = versions;
+    return true;
+}
+
+/**
+* versionsCollect: Frees the retired nodes which no snapshot can see anymore.
+*
+* @param queue - Target persistent queue.
+*/
+static void versionsCollect(PriorityQueue queue)
+{
+    Versions versions = queue->versions;
+    int count = 0;
+    while(count < versions->retired_count &&
+          (!versions->oldest || versions->retired[count]->order < versions->oldest->sequence))
+    {
+        Node node = versions->retired[count++];
+        queueCount(queue, node->element, node->priority, false);
+        if(node->element)
+        {
+            queue->free_element(node->element);
+        }
+        keyFree(queue, node->priority);
+        poolFree(queue->pool, node);
+    }
+    if(count > 0)
+    {
+        memmove(versions->retired, versions->retired + count, (versions->retired_count - count) * sizeof(Node));
+        versions->retired_count -= count;
+    }
+}
+
+/**
+* versionsDestroy: Deallocates the versions of a persistent queue, whose snapshots were all released.
+*
+* @param queue - Target persistent queue.
+*/
+static void versionsDestroy(PriorityQueue queue)
+{
+    versionsCollect(queue);
+    free(queue->versions->retired);
+    pqNodePoolDestroy(queue->versions->entry_pool);
+    free(queue->versions);
+    queue->versions = NULL;
+}
+
+/**
+* versionsReserve: Makes sure that count more nodes can be retired, if the queue has snapshots.
+*
+* @param queue - Target persistent queue.
+* @param count - The number of nodes to make room for.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool versionsReserve(PriorityQueue queue, int count)
+{
+    Versions versions = queue->versions;
+    if(!versions->oldest || versions->retired_count + count <= versions->retired_capacity)
+    {
+        return true;
+    }
+    int capacity = versions->retired_capacity > 0 ? versions->retired_capacity : INITIAL_CAPACITY;
+    while(capacity < versions->retired_count + count)
+    {
+        capacity *= EXPAND_FACTOR;
+    }
+    Node* retired = realloc(versions->retired, capacity * sizeof(*retired));
+    if(!retired)
+    {
+        return false;
+    }
+    versions->retired = retired;
+    versions->retired_capacity = capacity;
+    return true;
+}
+
+/**
+* versionsCommit: Makes a new version the current version of the queue.
+*
+* @param queue - Target persistent queue.
+* @param root - The new version, whose reference is handed over to the queue.
+*/
+static void versionsCommit(PriorityQueue queue, VersionEntry root)
+{
+    versionEntryRelease(queue, queue->versions->root);
+    queue->versions->root = root;
+}
+
+/**
+* versionsInsert: Adds the entry of a node, which is about to be inserted to the queue, to the current version.
+*
+* @param queue - Target persistent queue.
+* @param node - The node, with the order it is about to get.
+* @return
+* 	false if an allocation failed, the version is not changed.
+* 	Otherwise true.
+*/
+static bool versionsInsert(PriorityQueue queue, Node node)
+{
+    VersionEntry entry = versionEntryCreate(queue, node->element, node->priority, node->order);
+    if(!entry)
+    {
+        return false;
+    }
+    VersionEntry root = versionInsert(queue, queue->versions->root, entry);
+    versionEntryRelease(queue, entry);
+    if(!root)
+    {
+        return false;
+    }
+    versionsCommit(queue, root);
+    return true;
+}
+
+/**
+* versionsRemove: Removes the entry of a node, which is about to be removed from the queue, from the
+*           current version, and makes room to retire the node.
+*
+* @param queue - Target priority queue.
+* @param node - The node.
+* @return
+* 	false if an allocation failed, the version is not changed.
+* 	Otherwise true.
+*/
+static bool versionsRemove(PriorityQueue queue, Node node)
+{
+    if(!queue->versions)
+    {
+        return true;
+    }
+    VersionEntry root = NULL;
+    if(!versionsReserve(queue, 1) || !versionRemove(queue, queue->versions->root, node->priority, node->order, &root))
+    {
+        return false;
+    }
+    versionsCommit(queue, root);
+    return true;
+}
+
+/**
+* versionsMerge: Creates a version of a persistent queue with the entries of the nodes of another queue,
+*           which are about to be moved into it. The current version is not changed.
+*
+* @param destination - Target persistent queue.
+* @param source - The queue whose nodes are about to be moved, with the orders they have before the move.
+* @param result - Pointer to assign the new version into.
+* @return
+* 	false if an allocation failed, nothing is assigned.
+* 	Otherwise true, and the caller holds a reference to the new version.
+*/
+static bool versionsMerge(PriorityQueue destination, PriorityQueue source, VersionEntry* result)
+{
+    VersionEntry root = destination->versions->root;
+    if(root)
+    {
+        root->ref_count++;
+    }
+    for(int i = 0; i < source->size; i++)
+    {
+        Node node = source->nodes[i];
+        VersionEntry entry = versionEntryCreate(destination, node->element, node->priority,
+                                                node->order + destination->next_order);
+        VersionEntry inserted = entry ? versionInsert(destination, root, entry) : NULL;
+        versionEntryRelease(destination, entry);
+        versionEntryRelease(destination, root);
+        if(!inserted)
+        {
+            return false;
+        }
+        root = inserted;
+    }
+    *result = root;
+    return true;
+}
+
+/**
+* queueDiscard: Deallocates a node which was removed from the queue. If the queue has snapshots,
+*           the node is retired instead, and room for it must have been made by versionsReserve.
+*
+* @param queue - The priority queue which held the node.
+* @param node - The node to deallocate.
+*/
+static void queueDiscard(PriorityQueue queue, Node node)
+{
+    if(!queueIsPinned(queue))
+    {
+        nodeDestroy(queue, node);
+        return;
+    }
+    node->order = queue->versions->sequence;
+    queue->versions->retired[queue->versions->retired_count++] = node;
+}
+
+/**
+* versionsChange: Replaces the entry of a node, whose priority is about to be changed, in the current version.
+*           If the queue has snapshots, the old priority is retired in a node of its own.
+*
+* @param queue - Target persistent queue.
+* @param node - The node, which still has its old priority and order.
+* @param priority - The new priority of the node.
+* @return
+* 	false if an allocation failed, the version is not changed.
+* 	Otherwise true.
+*/
+static bool versionsChange(PriorityQueue queue, Node node, PQElementPriority priority)
+{
+    Node retired = NULL;
+    if(queueIsPinned(queue) && !keyIsInline(queue))
+    {
+        if(!versionsReserve(queue, 1) || !(retired = poolAllocate(queue->pool)))
+        {
+            return false;
+        }
+        STATS_ADD(queue, node_allocations, 1);
+    }
+    VersionEntry entry = versionEntryCreate(queue, node->element, priority, queue->next_order);
+    VersionEntry removed = NULL;
+    VersionEntry root = NULL;
+    if(entry && versionRemove(queue, queue->versions->root, node->priority, node->order, &removed))
+    {
+        root = versionInsert(queue, removed, entry);
+        versionEntryRelease(queue, removed);
+    }
+    versionEntryRelease(queue, entry);
+    if(!root)
+    {
+        if(retired)
+        {
+            poolFree(queue->pool, retired);
+        }
+        return false;
+    }
+    versionsCommit(queue, root);
+    if(retired)
+    {
+        retired->element = NULL;
+        retired->priority = node->priority;
+        queueDiscard(queue, retired);
+    }
+    return true;
+}
+
+/**
+* indexSlot: Returns the slot of the hash index in which the search for a hash value starts.
+*           The hash value is mixed first, so consecutive values are spread over the index.
+*
+* @param hash - The hash value of the element.
+* @param capacity - The number of slots in the index, which is a power of 2.
+* @return
+* 	The first slot to probe.
+*/
+static int indexSlot(unsigned long hash, int capacity)
+{
+    unsigned long long mixed = (unsigned long long)hash * HASH_MULTIPLIER;
+    return (int)((mixed ^ (mixed >> 32)) & (unsigned long long)(capacity - 1));
+}
+
+/**
+* indexPlace: Puts a node in the first free slot of a hash index, starting from its hash slot.
+*
+* @param index - The slots of the hash index.
+* @param capacity - The number of slots in the index, which must have a free slot.
+* @param node - The node to put.
+*/
+static void indexPlace(Node* index, int capacity, Node node)
+{
+    int slot = indexSlot(node->hash, capacity);
+    while(index[slot])
+    {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    index[slot] = node;
+}
+
+/**
+* indexReserve: Makes sure the hash index has room for count more nodes, doubling it as needed.
+*
+* @param queue - Target priority queue.
+* @param count - The number of nodes to make room for.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool indexReserve(PriorityQueue queue, int count)
+{
+    if((queue->size + count) * INDEX_LOAD_FACTOR <= queue->index_capacity)
+    {
+        return true;
+    }
+    int new_capacity = queue->index_capacity;
+    while(new_capacity < (queue->size + count) * INDEX_LOAD_FACTOR)
+    {
+        new_capacity *= EXPAND_FACTOR;
+    }
+    Node* new_index = calloc(new_capacity, sizeof(*new_index));
+    if(!new_index)
+    {
+        return false;
+    }
+    for(int i = 0; i < queue->size; i++)
+    {
+        if(queue->nodes[i]->element)
+        {
+            indexPlace(new_index, new_capacity, queue->nodes[i]);
+        }
+    }
+    free(queue->index);
+    queue->index = new_index;
+    queue->index_capacity = new_capacity;
+    return true;
+}
+
+/**
+* indexRemove: Removes a node from the hash index. The nodes after it in the same cluster
+*           are shifted back, so no search has to pass an empty slot to reach them.
+*
+* @param queue - Target priority queue.
+* @param node - The node to remove.
+*/
+static void indexRemove(PriorityQueue queue, Node node)
+{
+    int mask = queue->index_capacity - 1;
+    int slot = indexSlot(node->hash, queue->index_capacity);
+    while(queue->index[slot] != node)
+    {
+        slot = (slot + 1) & mask;
+    }
+    int next = (slot + 1) & mask;
+    while(queue->index[next])
+    {
+        int home = indexSlot(queue->index[next]->hash, queue->index_capacity);
+        if(((next - home) & mask) >= ((next - slot) & mask))
+        {
+            queue->index[slot] = queue->index[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    queue->index[slot] = NULL;
+}
+
+/**
+* queueAdd: Inserts a node to the backend and to the hash index, if the queue has one.
+*           The node gets the next insertion order.
+*
+* @param queue - Target priority queue.
+* @param node - The node to insert.
+* @return
+* 	false if an allocation failed, the node was not inserted.
+* 	Otherwise true.
+*/
+static bool queueAdd(PriorityQueue queue, Node node)
+{
+    if(queue->hash_element)
+    {
+        if(!indexReserve(queue, 1))
+        {
+            return false;
+        }
+        node->hash = queue->hash_element(node->element);
+    }
+    if(!nodesReserve(queue, 1))
+    {
+        return false;
+    }
+    node->order = queue->next_order;
+    if(queue->versions && !versionsInsert(queue, node))
+    {
+        return false;
+    }
+    queue->next_order++;
+    nodePlace(queue, node, queue->size);
+    queue->size++;
+    queue->backend->insert(queue, node);
+    if(queue->hash_element)
+    {
+        indexPlace(queue->index, queue->index_capacity, node);
+    }
+    queueUpdatePeak(queue);
+    return true;
+}
+
+/**
+* queueReserve: Makes sure the nodes array and the hash index have room for count more nodes.
+*
+* @param queue - Target priority queue.
+* @param count - The number of nodes to make room for.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool queueReserve(PriorityQueue queue, int count)
+{
+    return nodesReserve(queue, count) && (!queue->hash_element || indexReserve(queue, count));
+}
+
+/**
+* queueIndexFrom: Adds the nodes of the nodes array from index first onwards to the hash index,
+*           if the queue has one.
+*
+* @param queue - Target priority queue, with room in its hash index for all of its nodes.
+* @param first - The index in the nodes array of the first node to add.
+*/
+static void queueIndexFrom(PriorityQueue queue, int first)
+{
+    if(!queue->hash_element)
+    {
+        return;
+    }
+    for(int i = first; i < queue->size; i++)
+    {
+        Node node = queue->nodes[i];
+        node->hash = queue->hash_element(node->element);
+        indexPlace(queue->index, queue->index_capacity, node);
+    }
+}
+
+/**
+* queueBuild: Arranges the nodes put in the nodes array by the backend, and adds them
+*           to the hash index, if the queue has one.
+*
+* @param queue - Target priority queue, with room in its hash index for all of its nodes.
+*/
+static void queueBuild(PriorityQueue queue)
+{
+    queue->backend->build(queue);
+    queueIndexFrom(queue, 0);
+}
+
+/**
+* queueBuildFrom: Adds the nodes put at the end of the nodes array from index first onwards to the backend
+*           and to the hash index. The sorted array merges them in, the heaps are rebuilt in O(n) if that is
+*           cheaper than inserting the new nodes one by one, and the other backends insert them one by one.
+*
+* @param queue - Target priority queue, with room in its hash index for all of its nodes.
+* @param first - The index of the first new node.
+*/
+static void queueBuildFrom(PriorityQueue queue, int first)
+{
+    queueIndexFrom(queue, first);
+    int added = queue->size - first;
+    int log_size = 0;
+    for(int size = queue->size; size > 1; size /= 2)
+    {
+        log_size++;
+    }
+    if(queue->backend->sorted)
+    {
+        sortedBuildFrom(queue, first);
+    }
+    else if(queue->backend->linear_build && (long)added * log_size >= queue->size)
+    {
+        queue->backend->build(queue);
+    }
+    else
+    {
+        queue->size = first;
+        for(int i = 0; i < added; i++)
+        {
+            queue->size++;
+            queue->backend->insert(queue, queue->nodes[queue->size - 1]);
+        }
+    }
+}
+
+/**
+* queueFirst: Returns the first node of a non-empty queue.
+*
+* @param queue - Target priority queue.
+* @return
+* 	The first node.
+*/
+static Node queueFirst(PriorityQueue queue)
+{
+    return queue->backend->first(queue);
+}
+
+/**
+* queuePurge: Deallocates the dead nodes at the front of the queue, so its first node, if any, is alive.
+*
+* @param queue - Target priority queue.
+*/
+static void queuePurge(PriorityQueue queue)
+{
+    while(queue->dead > 0 && queue->size > 0 && !queueFirst(queue)->element)
+    {
+        Node node = queueFirst(queue);
+        queue->backend->remove(queue, node);
+        nodeDestroy(queue, node);
+        queue->dead--;
+    }
+}
+
+/**
+* queueDetach: Removes a node from the backend and from the hash index, without deallocating it.
+*           Dead nodes which it leaves at the front of the queue are deallocated.
+*
+* @param queue - Target priority queue.
+* @param node - The node to remove.
+* @return
+* 	The removed node.
+*/
+static Node queueDetach(PriorityQueue queue, Node node)
+{
+    queue->backend->remove(queue, node);
+    if(queue->hash_element)
+    {
+        indexRemove(queue, node);
+    }
+    queuePurge(queue);
+    return node;
+}
+
+/**
+* nodeSetPriority: Replaces the priority of a node in the queue. The node is considered
+*           as reinserted, so it gets the next insertion order.
+*
+* @param queue - Target priority queue.
+* @param node - The node to change.
+* @param priority - The new priority, which the node takes ownership of, unless it is an inline key.
+* @return
+* 	false if an allocation failed, the node is not changed and does not take ownership of priority.
+* 	Otherwise true.
+*/
+static bool nodeSetPriority(PriorityQueue queue, Node node, PQElementPriority priority)
+{
+    if(queue->versions && !versionsChange(queue, node, priority))
+    {
+        return false;
+    }
+    if(!queueIsPinned(queue))
+    {
+        queueCount(queue, NULL, node->priority, false);
+        keyFree(queue, node->priority);
+    }
+    nodeSetKey(queue, node, priority);
+    queueCount(queue, NULL, node->priority, true);
+    queueUpdatePeak(queue);
+    node->order = queue->next_order++;
+    queue->backend->fix(queue, node);
+    queuePurge(queue);
+    return true;
+}
+
+/**
+* nodeIsInQueue: Checks if a handle belongs to a node which is currently in the queue, and is not dead.
+*
+* @param queue - Target priority queue.
+* @param node - The node to check.
+* @return
+* 	true if the node is in the queue.
+* 	Otherwise false.
+*/
+static bool nodeIsInQueue(PriorityQueue queue, Node node)
+{
+    return node->index >= 0 && node->index < queue->size && queue->nodes[node->index] == node && node->element;
+}
+
+/**
+* queueChanged: Starts a new generation of the queue after it was changed, which makes
+*           the sorted array and the iterator out of date.
+*
+* @param queue - Target priority queue.
+*/
+static void queueChanged(PriorityQueue queue)
+{
+    queue->generation++;
+}
+
+/**
+* queueCompact: Deallocates all the dead nodes of the queue and rebuilds the backend from the live ones,
+*           in O(n) for the heaps. Does nothing if the queue has no dead nodes.
+*
+* @param queue - Target priority queue, which does not share its nodes.
+*/
+static void queueCompact(PriorityQueue queue)
+{
+    if(queue->dead == 0)
+    {
+        return;
+    }
+    int live = 0;
+    for(int i = 0; i < queue->size; i++)
+    {
+        Node node = queue->nodes[i];
+        if(node->element)
+        {
+            nodePlace(queue, node, live++);
+        }
+        else
+        {
+            nodeDestroy(queue, node);
+        }
+    }
+    queue->size = live;
+    queue->dead = 0;
+    queue->backend->build(queue);
+    queueChanged(queue);
+}
+
+/**
+* queueKill: Removes a node lazily - frees its element and leaves the node in the backend as a dead node,
+*           in O(1) unless it is the first node. The queue is compacted once its ratio of dead nodes passes
+*           tombstone_ratio, so the compaction takes O(1) amortized time per removal.
+*
+* @param queue - Target priority queue, which does not share its nodes.
+* @param node - The node to remove.
+*/
+static void queueKill(PriorityQueue queue, Node node)
+{
+    if(queue->hash_element)
+    {
+        indexRemove(queue, node);
+    }
+    queueCount(queue, node->element, NULL, false);
+    queue->free_element(node->element);
+    node->element = NULL;
+    queue->dead++;
+    queuePurge(queue);
+    if(queue->dead > queue->tombstone_ratio * queue->size)
+    {
+        queueCompact(queue);
+    }
+}
+
+/**
+* queueErase: Removes a node which was found by its element or by its handle - lazily if the queue uses
+*           lazy removal, and otherwise at once.
+*
+* @param queue - Target priority queue, which does not share its nodes.
+* @param node - The node to remove.
+*/
+static void queueErase(PriorityQueue queue, Node node)
+{
+    if(queue->lazy_removal)
+    {
+        queueKill(queue, node);
+        return;
+    }
+    queueDiscard(queue, queueDetach(queue, node));
+}
+
+/**
+* queueIteratorIsValid: Checks if the iterator points to an element of the current generation.
+*
+* @param queue - Target priority queue.
+* @return
+* 	true if the iterator can be advanced.
+* 	Otherwise false.
+*/
+static bool queueIteratorIsValid(PriorityQueue queue)
+{
+    return queue->iterator != INVALID_ITERATOR && queue->iterator_generation == queue->generation;
+}
+
+/**
+* queueSort: Builds the sorted array of the queue, if it is not up to date and the nodes array is not sorted.
+*
+* @param queue - Target priority queue.
+* @return
+* 	false if an allocation failed.
+* 	Otherwise true.
+*/
+static bool queueSort(PriorityQueue queue)
+{
+    if(queue->backend->sorted || queue->sorted_generation == queue->generation)
+    {
+        return true;
+    }
+    Node* sorted = realloc(queue->sorted, queue->capacity * sizeof(*sorted));
+    if(!sorted)
+    {
+        return false;
+    }
+    queue->sorted = sorted;
+    for(int i = 0; i < queue->size; i++)
+    {
+        sorted[i] = queue->nodes[i];
+    }
+    if(!nodesSort(queue, sorted, queue->size))
+    {
+        return false;
+    }
+    queue->sorted_generation = queue->generation;
+    return true;
+}
+
+/**
+* queueFind: Finds the first node in the queue which holds an element equal to element.
+*           If priority is not NULL, the node must also have a priority equal to priority.
+*
+* @param queue - Target priority queue.
+* @param element - The element to look for.
+* @param priority - The priority to look for, or NULL for any priority.
+* @return
+* 	-1 if there is no such node.
+* 	Otherwise the index of the node in the heap.
+*/
+static int queueFind(PriorityQueue queue, PQElement element, PQElementPriority priority)
+{
+    int found = -1;
+    bool use_index = queue->hash_element != NULL;
+    int mask = queue->index_capacity - 1;
+    int slot = use_index ? indexSlot(queue->hash_element(element), queue->index_capacity) : 0;
+    for(int i = 0; use_index ? queue->index[slot] != NULL : i < queue->size; i++)
+    {
+        Node node = use_index ? queue->index[slot] : queue->nodes[i];
+        slot = (slot + 1) & mask;
+        if(!node->element)
+        {
+            continue;
+        }
+        STATS_ADD(queue, equal_calls, 1);
+        if(!queue->equal_elements(node->element, element))
+        {
+            continue;
+        }
+        if(priority && keyCompare(queue, priority, node->priority) != 0)
+        {
+            continue;
+        }
+        if(found == -1 || nodeIsBefore(queue, node, queue->nodes[found]))
+        {
+            found = node->index;
+        }
+    }
+    return found;
+}
+
+/**
+* indexFind: Finds the highest priority element with a hash value which match accepts,
+*           through the hash index.
+*
+* @param queue - Target priority queue, which has a hash index.
+* @param hash - The hash value of the element.
+* @param match - Function which accepts the element looked for.
+* @param context - Passed to match.
+* @return
+* 	-1 if there is no such node.
+* 	Otherwise the index of the node in the heap.
+*/
+static int indexFind(PriorityQueue queue, unsigned long hash, MatchPQElement match, void* context)
+{
+    int found = -1;
+    int mask = queue->index_capacity - 1;
+    for(int slot = indexSlot(hash, queue->index_capacity); queue->index[slot] != NULL; slot = (slot + 1) & mask)
+    {
+        Node node = queue->index[slot];
+        if(node->hash != hash || !match(node->element, context))
+        {
+            continue;
+        }
+        if(found == -1 || nodeIsBefore(queue, node, queue->nodes[found]))
+        {
+            found = node->index;
+        }
+    }
+    return found;
+}
+
+
+/**
+* queueIsShared: Checks if the nodes of the queue are shared with copies of it.
+*
+* @param queue - Target priority queue.
+* @return
+* 	true if the nodes are shared.
+* 	Otherwise false.
+*/
+static bool queueIsShared(PriorityQueue queue)
+{
+    return queue->sharers && *queue->sharers > 1;
+}
+
+/**
+* queueShare: Creates a copy of the queue in O(1), which shares the nodes of the queue.
+*
+* @param queue - Target priority queue.
+* @return
+* 	NULL if an allocation failed.
+* 	A copy of the queue otherwise.
+*/
+static PriorityQueue queueShare(PriorityQueue queue)
+{
+    queueCompact(queue);
+    if(!queue->sharers)
+    {
+        queue->sharers = malloc(sizeof(*queue->sharers));
+        if(!queue->sharers)
+        {
+            return NULL;
+        }
+        *queue->sharers = 1;
+    }
+    PriorityQueue new_queue = malloc(sizeof(*new_queue));
+    if(!new_queue)
+    {
+        return NULL;
+    }
+    *new_queue = *queue;
+    new_queue->generation = 1;
+    new_queue->sorted = NULL;
+    new_queue->sorted_generation = 0;
+    new_queue->iterator = INVALID_ITERATOR;
+    new_queue->iterator_generation = 0;
+    STATS_RESET(new_queue);
+    new_queue->pool->ref_count++;
+    if(new_queue->lock)
+    {
+        new_queue->lock->ref_count++;
+    }
+    (*queue->sharers)++;
+    queue->iterator = INVALID_ITERATOR;
+    return new_queue;
+}
+
+/**
+* queueUnshare: Gives the queue its own copy of the nodes it shares, before it is changed.
+*           The elements and priorities are copied using the copy functions.
+*
+* @param queue - Target priority queue.
+* @return
+* 	false if an allocation failed, the queue still shares its nodes.
+* 	Otherwise true.
+*/
+static bool queueUnshare(PriorityQueue queue)
+{
+    if(!queueIsShared(queue))
+    {
+        return true;
+    }
+    Node* nodes = malloc(queue->capacity * sizeof(*nodes));
+    Node* index = queue->hash_element ? calloc(queue->index_capacity, sizeof(*index)) : NULL;
+    size_t shared_element_bytes = queue->element_bytes;
+    size_t shared_priority_bytes = queue->priority_bytes;
+    Calendar shared_calendar = queue->calendar;
+    SkipList shared_skip_list = queue->skip_list;
+    KeyArray shared_key_array = queue->key_array;
+    if(!nodes || (queue->hash_element && !index) || (queue->backend->create && !queue->backend->create(queue)))
+    {
+        free(nodes);
+        free(index);
+        return false;
+    }
+    for(int i = 0; i < queue->size; i++)
+    {
+        Node shared = queue->nodes[i];
+        Node node = nodeCreate(queue, shared->element, shared->priority);
+        if(!node)
+        {
+            for(int j = 0; j < i; j++)
+            {
+                nodeDestroy(queue, nodes[j]);
+            }
+            free(nodes);
+            free(index);
+            if(queue->backend->destroy)
+            {
+                queue->backend->destroy(queue);
+            }
+            queue->calendar = shared_calendar;
+            queue->skip_list = shared_skip_list;
+            queue->key_array = shared_key_array;
+            return false;
+        }
+        node->order = shared->order;
+        node->hash = shared->hash;
+        node->index = i;
+        nodes[i] = node;
+        if(index)
+        {
+            indexPlace(index, queue->index_capacity, node);
+        }
+    }
+    (*queue->sharers)--;
+    queue->sharers = NULL;
+    queue->nodes = nodes;
+    queue->index = index;
+    queue->element_bytes -= shared_element_bytes;
+    queue->priority_bytes -= shared_priority_bytes;
+    queue->backend->build(queue);
+    queueChanged(queue);
+    return true;
+}
+
+/**
+* queueInsert: Inserts an element with a priority to the queue.
+*
+* @param queue - Target priority queue.
+* @param element - The element to insert.
+* @param priority - The priority of the element.
+* @param owned - true if the queue takes ownership of element and priority, false if it copies them.
+* @param handle - Pointer to assign the handle of the inserted element into, or NULL.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_OUT_OF_MEMORY if an allocation failed, an owned element and priority stay with the caller.
+* 	PQ_SUCCESS the element had been inserted successfully
+*/
+static PriorityQueueResult queueInsert(PriorityQueue queue, PQElement element, PQElementPriority priority,
+                                       bool owned, PQHandle* handle)
+{
+    if(!queue || !element || !priority)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    if(!queueUnshare(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueChanged(queue);
+    Node to_add = owned ? nodeAdopt(queue, element, priority) : nodeCreate(queue, element, priority);
+    if(!to_add)
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    bool added = false;
+    STATS_ADD(queue, inserts, 1);
+    STATS_SPAN(queue, insert_scanned, key_comparisons, added = queueAdd(queue, to_add));
+    if(!added)
+    {
+        if(owned)
+        {
+            queueCount(queue, to_add->element, to_add->priority, false);
+            poolFree(queue->pool, to_add);
+        }
+        else
+        {
+            nodeDestroy(queue, to_add);
+        }
+        return PQ_OUT_OF_MEMORY;
+    }
+    if(handle)
+    {
+        *handle = to_add;
+    }
+    return PQ_SUCCESS;
+}
+
+/**
+* queueChangePriority: Changes the priority of the first element equal to element with a priority
+*           equal to old_priority.
+*
+* @param queue - Target priority queue.
+* @param element - The element to find.
+* @param old_priority - The current priority of the element.
+* @param new_priority - The new priority of the element.
+* @param owned - true if the queue takes ownership of new_priority, false if it copies it.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_OUT_OF_MEMORY if an allocation failed
+* 	PQ_ELEMENT_DOES_NOT_EXISTS if element with old_priority does not exists in the queue,
+* 	an owned new_priority stays with the caller.
+* 	PQ_SUCCESS the priority had been changed successfully
+*/
+static PriorityQueueResult queueChangePriority(PriorityQueue queue, PQElement element,
+                                               PQElementPriority old_priority, PQElementPriority new_priority,
+                                               bool owned)
+{
+    if(!queue || !element || !old_priority || !new_priority)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    if(!queueUnshare(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueChanged(queue);
+    int index = queueFind(queue, element, old_priority);
+    if(index == -1)
+    {
+        return PQ_ELEMENT_DOES_NOT_EXISTS;
+    }
+    PQElementPriority priority = owned ? new_priority : keyCopy(queue, new_priority);
+    if(!priority)
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    if(!nodeSetPriority(queue, queue->nodes[index], priority))
+    {
+        if(!owned)
+        {
+            keyFree(queue, priority);
+        }
+        return PQ_OUT_OF_MEMORY;
+    }
+    return PQ_SUCCESS;
+}
+
+/**
+* queueHasSameFunctions: Checks if two queues use the same functions for their elements and priorities.
+*
+* @param queue1 - The first priority queue.
+* @param queue2 - The second priority queue.
+* @return
+* 	true if the queues have the same functions.
+* 	Otherwise false.
+*/
+static bool queueHasSameFunctions(PriorityQueue queue1, PriorityQueue queue2)
+{
+    return  queue1->copy_element == queue2->copy_element &&
+            queue1->free_element == queue2->free_element &&
+            queue1->equal_elements == queue2->equal_elements &&
+            queue1->copy_priority == queue2->copy_priority &&
+            queue1->free_priority == queue2->free_priority &&
+            queue1->compare_priorities == queue2->compare_priorities &&
+            queue1->key_type == queue2->key_type &&
+            queue1->key_size == queue2->key_size &&
+            queue1->lowest_first == queue2->lowest_first &&
+            queue1->backend_type == queue2->backend_type;
+}
+
+/**
+* backendIsValid: Checks if a backend can be used with a type of keys.
+*
+* @param backend_type - The backend to check.
+* @param key_type - The type of the keys of the queue.
+* @return
+* 	false if backend_type is not a backend, or if the backend cannot order keys of key_type.
+* 	Otherwise true.
+*/
+static bool backendIsValid(PQBackendType backend_type, PQKeyType key_type)
+{
+    if(backend_type < PQ_BACKEND_BINARY_HEAP || backend_type > PQ_BACKEND_SKIP_LIST)
+    {
+        return false;
+    }
+    return backend_type != PQ_BACKEND_CALENDAR || key_type == PQ_KEY_INT64;
+}
+
+/**
+* queueSetBackend: Makes an empty queue use a backend. If its node pool holds nodes of another size,
+*           the pool is emptied, or replaced with a new pool if it is shared.
+*
+* @param queue - Target priority queue, which is empty and not shared.
+* @param backend_type - The backend to use.
+* @param arity - The number of children of a node in a d-ary heap. Ignored by the other backends.
+* @return
+* 	PQ_OUT_OF_MEMORY if an allocation failed. The queue keeps its backend, unless the structure
+* 	of the new backend could not be allocated, in which case it uses the binary heap backend.
+* 	PQ_SUCCESS otherwise.
+*/
+static PriorityQueueResult queueSetBackend(PriorityQueue queue, PQBackendType backend_type, int arity)
+{
+    queue->arity = backend_type == PQ_BACKEND_DARY_HEAP ? arity : BINARY_HEAP_ARITY;
+    if(queue->backend_type == backend_type)
+    {
+        return PQ_SUCCESS;
+    }
+    int key_offset = queue->key_offset;
+    queue->key_offset = backends[backend_type].linked ? (sizeof(struct PQLinks_t) + sizeof(Unit) - 1) / sizeof(Unit) : 0;
+    int node_units = queueNodeUnits(queue);
+    if(queue->pool->node_units != node_units)
+    {
+        if(queue->pool->ref_count == 1 && queue->pool->used == 0)
+        {
+            poolRelease(queue->pool);
+        }
+        else
+        {
+            PQNodePool pool = pqNodePoolCreate();
+            if(!pool)
+            {
+                queue->key_offset = key_offset;
+                return PQ_OUT_OF_MEMORY;
+            }
+            pqNodePoolDestroy(queue->pool);
+            queue->pool = pool;
+        }
+        queue->pool->node_units = node_units;
+    }
+    if(queue->backend->destroy)
+    {
+        queue->backend->destroy(queue);
+    }
+    queue->backend_type = backend_type;
+    queue->backend = &backends[backend_type];
+    if(queue->backend->create && !queue->backend->create(queue))
+    {
+        queue->key_offset = 0;
+        queue->pool->node_units = queueNodeUnits(queue);
+        queue->arity = BINARY_HEAP_ARITY;
+        queue->backend_type = PQ_BACKEND_BINARY_HEAP;
+        queue->backend = &backends[PQ_BACKEND_BINARY_HEAP];
+        return PQ_OUT_OF_MEMORY;
+    }
+    return PQ_SUCCESS;
+}
+
+/**
+* queueCreate: Allocates a new empty priority queue, with a hash index if hash_element is not NULL.
+*           The priority functions are needed only if key_type is PQ_KEY_POINTER.
+*           The parameters are the same as in pqCreateWithHash and pqCreateWithInlineKeys.
+*
+* @return
+* 	NULL - if one of the required parameters is NULL or allocations failed.
+* 	A new priority queue in case of success.
+*/
+static PriorityQueue queueCreate(CopyPQElement copy_element,
+                                 FreePQElement free_element,
+                                 EqualPQElements equal_elements,
+                                 CopyPQElementPriority copy_priority,
+                                 FreePQElementPriority free_priority,
+                                 ComparePQElementPriorities compare_priorities,
+                                 PQKeyType key_type,
+                                 int key_size,
+                                 bool lowest_first,
+                                 HashPQElement hash_element)
+{
+    if(!copy_element || !free_element || !equal_elements)
+    {
+        return NULL;
+    }
+    if(key_type == PQ_KEY_POINTER && (!copy_priority || !free_priority || !compare_priorities))
+    {
+        return NULL;
+    }
+    PriorityQueue queue = malloc(sizeof(*queue));
+    if(!queue)
+    {
+        return NULL;
+    }
+    queue->nodes = malloc(INITIAL_CAPACITY * sizeof(*queue->nodes));
+    queue->index_capacity = hash_element ? INITIAL_CAPACITY * INDEX_LOAD_FACTOR : 0;
+    queue->index = hash_element ? calloc(queue->index_capacity, sizeof(*queue->index)) : NULL;
+    queue->pool = pqNodePoolCreate();
+    if(!queue->nodes || (hash_element && !queue->index) || !queue->pool)
+    {
+        free(queue->nodes);
+        free(queue->index);
+        pqNodePoolDestroy(queue->pool);
+        free(queue);
+        return NULL;
+    }
+    queue->key_type = key_type;
+    queue->key_size = key_type == PQ_KEY_POINTER ? 0 : key_size;
+    queue->lowest_first = lowest_first;
+    queue->backend_type = PQ_BACKEND_BINARY_HEAP;
+    queue->backend = &backends[PQ_BACKEND_BINARY_HEAP];
+    queue->key_offset = 0;
+    queue->arity = BINARY_HEAP_ARITY;
+    queue->calendar = NULL;
+    queue->skip_list = NULL;
+    queue->key_array = NULL;
+    queue->root = NULL;
+    queue->pool->node_units = queueNodeUnits(queue);
+    queue->hash_element = hash_element;
+    queue->size = 0;
+    queue->capacity = INITIAL_CAPACITY;
+    queue->next_order = 0;
+    queue->generation = 1;
+    queue->sorted = NULL;
+    queue->sorted_generation = 0;
+    queue->copy_element = copy_element;
+    queue->free_element = free_element;
+    queue->equal_elements = equal_elements;
+    queue->copy_priority = copy_priority;
+    queue->free_priority = free_priority;
+    queue->compare_priorities = compare_priorities;
+    queue->iterator = INVALID_ITERATOR;
+    queue->iterator_generation = 0;
+    queue->copy_on_write = false;
+    queue->sharers = NULL;
+    queue->lock = NULL;
+    queue->versions = NULL;
+    queue->size_element = NULL;
+    queue->size_priority = NULL;
+    queue->element_bytes = 0;
+    queue->priority_bytes = 0;
+    queue->peak_bytes = 0;
+    queue->lazy_removal = false;
+    queue->tombstone_ratio = DEFAULT_TOMBSTONE_RATIO;
+    queue->dead = 0;
+    STATS_RESET(queue);
+    return queue;
+}
+
+
+PriorityQueue pqCreate(CopyPQElement copy_element,
+                       FreePQElement free_element,
+                       EqualPQElements equal_elements,
+                       CopyPQElementPriority copy_priority,
+                       FreePQElementPriority free_priority,
+                       ComparePQElementPriorities compare_priorities)
+{
+    PQOptions options = {copy_element, free_element, equal_elements, copy_priority, free_priority,
+                         compare_priorities};
+    return pqCreateEx(&options);
+}
+
+
+PriorityQueue pqCreateWithHash(CopyPQElement copy_element,
+                               FreePQElement free_element,
+                               EqualPQElements equal_elements,
+                               CopyPQElementPriority copy_priority,
+                               FreePQElementPriority free_priority,
+                               ComparePQElementPriorities compare_priorities,
+                               HashPQElement hash_element)
+{
+    if(!hash_element)
+    {
+        return NULL;
+    }
+    PQOptions options = {copy_element, free_element, equal_elements, copy_priority, free_priority,
+                         compare_priorities, hash_element};
+    return pqCreateEx(&options);
+}
+
+
+PriorityQueue pqCreateWithInlineKeys(CopyPQElement copy_element,
+                                     FreePQElement free_element,
+                                     EqualPQElements equal_elements,
+                                     PQKeyType key_type,
+                                     int key_size,
+                                     bool lowest_first,
+                                     HashPQElement hash_element)
+{
+    if(key_type == PQ_KEY_POINTER)
+    {
+        return NULL;
+    }
+    PQOptions options = {copy_element, free_element, equal_elements, NULL, NULL, NULL, hash_element,
+                         key_type, key_size, lowest_first};
+    return pqCreateEx(&options);
+}
+
+
+PriorityQueue pqCreateEx(const PQOptions* options)
+{
+    if(!options)
+    {
+        return NULL;
+    }
+    int key_size = options->key_size;
+    if(options->key_type == PQ_KEY_INT64)
+    {
+        key_size = sizeof(int64_t);
+    }
+    else if(options->key_type == PQ_KEY_BYTES ? key_size <= 0 : options->key_type != PQ_KEY_POINTER)
+    {
+        return NULL;
+    }
+    int arity = options->arity ? options->arity : DEFAULT_ARITY;
+    if(!backendIsValid(options->backend, options->key_type) || arity < BINARY_HEAP_ARITY ||
+       (options->persistent && (options->copy_on_write || options->lazy_removal)) || options->tombstone_ratio < 0)
+    {
+        return NULL;
+    }
+    PriorityQueue queue = queueCreate(options->copy_element, options->free_element, options->equal_elements,
+                                      options->copy_priority, options->free_priority, options->compare_priorities,
+                                      options->key_type, key_size, options->lowest_first, options->hash_element);
+    if(!queue)
+    {
+        return NULL;
+    }
+    if(queueSetBackend(queue, options->backend, arity) != PQ_SUCCESS ||
+       (options->pool && pqSetNodePool(queue, options->pool) != PQ_SUCCESS))
+    {
+        pqDestroy(queue);
+        return NULL;
+    }
+    if((options->concurrent && !(queue->lock = lockCreate())) || (options->persistent && !versionsCreate(queue)))
+    {
+        pqDestroy(queue);
+        return NULL;
+    }
+    queue->copy_on_write = options->copy_on_write;
+    queue->size_element = options->size_element;
+    queue->size_priority = options->size_priority;
+    queue->lazy_removal = options->lazy_removal;
+    if(options->tombstone_ratio > 0)
+    {
+        queue->tombstone_ratio = options->tombstone_ratio;
+    }
+    return queue;
+}
+
+
+/**
+* queueIterBegin: pqIterBegin, for a queue locked by the caller. The sorted array is used if it is up to date,
+*           and otherwise the iterator sorts its own copy of the nodes, so the queue is only read.
+*/
+static PQIterator queueIterBegin(PriorityQueue queue)
+{
+    if(!queue)
+    {
+        return NULL;
+    }
+    PQIterator iterator = malloc(sizeof(*iterator) + queue->size * sizeof(Node));
+    if(!iterator)
+    {
+        return NULL;
+    }
+    iterator->queue = queue;
+    iterator->generation = queue->generation;
+    iterator->position = 0;
+    iterator->size = 0;
+    bool sorted = queue->backend->sorted || queue->sorted_generation == queue->generation;
+    Node* nodes = queue->backend->sorted || !sorted ? queue->nodes : queue->sorted;
+    for(int i = 0; i < queue->size; i++)
+    {
+        if(nodes[i]->element)
+        {
+            iterator->nodes[iterator->size++] = nodes[i];
+        }
+    }
+    if(!sorted && !nodesSort(queue, iterator->nodes, iterator->size))
+    {
+        free(iterator);
+        return NULL;
+    }
+    return iterator;
+}
+
+/**
+* queueClear: pqClear, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueClear(PriorityQueue queue)
+{
+    if(!queue)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    queueChanged(queue);
+    if(queueIsShared(queue))
+    {
+        Node* nodes = malloc(INITIAL_CAPACITY * sizeof(*nodes));
+        Node* index = queue->hash_element ? calloc(INITIAL_CAPACITY * INDEX_LOAD_FACTOR, sizeof(*index)) : NULL;
+        Calendar shared_calendar = queue->calendar;
+        SkipList shared_skip_list = queue->skip_list;
+        KeyArray shared_key_array = queue->key_array;
+        if(!nodes || (queue->hash_element && !index) || (queue->backend->create && !queue->backend->create(queue)))
+        {
+            free(nodes);
+            free(index);
+            queue->calendar = shared_calendar;
+            queue->skip_list = shared_skip_list;
+            queue->key_array = shared_key_array;
+            return PQ_OUT_OF_MEMORY;
+        }
+        (*queue->sharers)--;
+        queue->sharers = NULL;
+        queue->nodes = nodes;
+        queue->capacity = INITIAL_CAPACITY;
+        queue->element_bytes = 0;
+        queue->priority_bytes = 0;
+        queue->index = index;
+        queue->index_capacity = index ? INITIAL_CAPACITY * INDEX_LOAD_FACTOR : 0;
+        queue->size = 0;
+        queue->backend->build(queue);
+        return PQ_SUCCESS;
+    }
+    if(queueIsPinned(queue))
+    {
+        if(!versionsReserve(queue, queue->size))
+        {
+            return PQ_OUT_OF_MEMORY;
+        }
+        for(int i = 0; i < queue->size; i++)
+        {
+            queueDiscard(queue, queue->nodes[i]);
+        }
+    }
+    else
+    {
+        bool release_pool = queue->pool->ref_count == 1;
+        for(int i = 0; i < queue->size; i++)
+        {
+            Node node = queue->nodes[i];
+            queueCount(queue, node->element, node->priority, false);
+            if(node->element)
+            {
+                queue->free_element(node->element);
+            }
+            keyFree(queue, node->priority);
+            if(!release_pool)
+            {
+                poolFree(queue->pool, node);
+            }
+        }
+        if(release_pool)
+        {
+            poolRelease(queue->pool);
+        }
+    }
+    if(queue->versions)
+    {
+        versionsCommit(queue, NULL);
+    }
+    for(int i = 0; i < queue->index_capacity; i++)
+    {
+        queue->index[i] = NULL;
+    }
+    queue->size = 0;
+    queue->dead = 0;
+    queue->backend->build(queue);
+    return PQ_SUCCESS;
+}
+
+
+/**
+* queueDestroy: Deallocates the queue, like pqDestroy, without releasing its lock.
+*/
+static void queueDestroy(PriorityQueue queue)
+{
+    if(!queue)
+    {
+        return;
+    }
+    if(queueIsShared(queue))
+    {
+        (*queue->sharers)--;
+    }
+    else
+    {
+        queueClear(queue);
+        if(queue->backend->destroy)
+        {
+            queue->backend->destroy(queue);
+        }
+        if(queue->versions)
+        {
+            versionsDestroy(queue);
+        }
+        free(queue->nodes);
+        free(queue->index);
+        free(queue->sharers);
+    }
+    free(queue->sorted);
+    pqNodePoolDestroy(queue->pool);
+    free(queue);
+}
+
+
+void pqDestroy(PriorityQueue queue)
+{
+    if(!queue)
+    {
+        return;
+    }
+    Lock lock = queue->lock;
+    lockAcquire(lock);
+    queueDestroy(queue);
+    lockDrop(lock);
+}
+
+
+/**
+* queueCopy: Copies the queue, like pqCopy. A copy which shares the nodes of the queue also shares its lock,
+*           and any other copy of a concurrent queue gets a lock of its own.
+*/
+static PriorityQueue queueCopy(PriorityQueue queue)
+{
+    if(!queue)
+    {
+        return NULL;
+    }
+    if(queue->copy_on_write)
+    {
+        return queueShare(queue);
+    }
+    PriorityQueue new_queue = queueCreate(  queue->copy_element,
+                                            queue->free_element,
+                                            queue->equal_elements,
+                                            queue->copy_priority,
+                                            queue->free_priority,
+                                            queue->compare_priorities,
+                                            queue->key_type,
+                                            queue->key_size,
+                                            queue->lowest_first,
+                                            queue->hash_element);
+    if(!new_queue)
+    {
+        return NULL;
+    }
+    queue->iterator = INVALID_ITERATOR;
+    new_queue->size_element = queue->size_element;
+    new_queue->size_priority = queue->size_priority;
+    new_queue->lazy_removal = queue->lazy_removal;
+    new_queue->tombstone_ratio = queue->tombstone_ratio;
+    if(queueSetBackend(new_queue, queue->backend_type, queue->arity) != PQ_SUCCESS || !queueReserve(new_queue, queue->size))
+    {
+        pqDestroy(new_queue);
+        return NULL;
+    }
+    for(int i = 0; i < queue->size; i++)
+    {
+        if(!queue->nodes[i]->element)
+        {
+            continue;
+        }
+        Node node = nodeCreate(new_queue, queue->nodes[i]->element, queue->nodes[i]->priority);
+        if(!node)
+        {
+            pqDestroy(new_queue);
+            return NULL;
+        }
+        node->order = queue->nodes[i]->order;
+        nodePlace(new_queue, node, new_queue->size);
+        new_queue->size++;
+    }
+    queueBuild(new_queue);
+    if((queue->lock && !(new_queue->lock = lockCreate())) || (queue->versions && !versionsCreate(new_queue)))
+    {
+        pqDestroy(new_queue);
+        return NULL;
+    }
+    for(int i = 0; new_queue->versions && i < new_queue->size; i++)
+    {
+        if(!versionsInsert(new_queue, new_queue->nodes[i]))
+        {
+            pqDestroy(new_queue);
+            return NULL;
+        }
+    }
+    new_queue->next_order = queue->next_order;
+    new_queue->copy_on_write = queue->copy_on_write;
+    queueUpdatePeak(new_queue);
+    return new_queue;
+}
+
+
+PriorityQueue pqCopy(PriorityQueue queue)
+{
+    queueLock(queue);
+    PriorityQueue result = queueCopy(queue);
+    queueUnlock(queue);
+    return result;
+}
+
+
+PriorityQueue pqCreateFromArray(CopyPQElement copy_element,
+                                FreePQElement free_element,
+                                EqualPQElements equal_elements,
+                                CopyPQElementPriority copy_priority,
+                                FreePQElementPriority free_priority,
+                                ComparePQElementPriorities compare_priorities,
+                                PQElement* elements,
+                                PQElementPriority* priorities,
+                                int size,
+                                bool owned)
+{
+    if(!elements || !priorities || size < 0)
+    {
+        return NULL;
+    }
+    PriorityQueue queue = queueCreate(copy_element, free_element, equal_elements, copy_priority, free_priority,
+                                      compare_priorities, PQ_KEY_POINTER, 0, false, NULL);
+    if(!queue)
+    {
+        return NULL;
+    }
+    if(!queueReserve(queue, size))
+    {
+        pqDestroy(queue);
+        return NULL;
+    }
+    for(int i = 0; i < size; i++)
+    {
+        Node node = NULL;
+        if(elements[i] && priorities[i])
+        {
+            node = owned ? nodeAdopt(queue, elements[i], priorities[i]) : nodeCreate(queue, elements[i], priorities[i]);
+        }
+        if(!node)
+        {
+            if(owned)
+            {
+                for(int j = 0; j < queue->size; j++)
+                {
+                    poolFree(queue->pool, queue->nodes[j]);
+                }
+                queue->size = 0;
+            }
+            pqDestroy(queue);
+            return NULL;
+        }
+        node->order = queue->next_order++;
+        nodePlace(queue, node, i);
+        queue->size++;
+    }
+    queueBuild(queue);
+    return queue;
+}
+
+
+int pqGetSize(PriorityQueue queue)
+{
+    if(!queue)
+    {
+        return -1;
+    }
+    queueLock(queue);
+    int size = queue->size - queue->dead;
+    queueUnlock(queue);
+    return size;
+}
+
+
+/**
+* queueContains: pqContains, for a queue locked by the caller.
+*/
+static bool queueContains(PriorityQueue queue, PQElement element)
+{
+    if(!queue || !element)
+    {
+        return false;
+    }
+    if(queue->hash_element)
+    {
+        return queueFind(queue, element, NULL) != -1;
+    }
+    for(int i = 0; i < queue->size; i++)
+    {
+        if(!queue->nodes[i]->element)
+        {
+            continue;
+        }
+        STATS_ADD(queue, equal_calls, 1);
+        if(queue->equal_elements(queue->nodes[i]->element, element))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool pqContains(PriorityQueue queue, PQElement element)
+{
+    queueLock(queue);
+    bool result = queueContains(queue, element);
+    queueUnlock(queue);
+    return result;
+}
+
+
+PriorityQueueResult pqInsert(PriorityQueue queue, PQElement element, PQElementPriority priority)
+{
+    return pqInsertWithHandle(queue, element, priority, NULL);
+}
+
+
+PriorityQueueResult pqInsertWithHandle(PriorityQueue queue, PQElement element, PQElementPriority priority,
+                                       PQHandle* handle)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueInsert(queue, element, priority, false, handle);
+    queueUnlock(queue);
+    return result;
+}
+
+
+PriorityQueueResult pqInsertOwned(PriorityQueue queue, PQElement element, PQElementPriority priority)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueInsert(queue, element, priority, true, NULL);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueInsertBatch: pqInsertBatch, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueInsertBatch(PriorityQueue queue, PQElement* elements, PQElementPriority* priorities,
+                                            int size, PriorityQueueResult* results)
+{
+    if(!queue || size < 0 || (size > 0 && (!elements || !priorities)))
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    PriorityQueueResult result = PQ_SUCCESS;
+    if(queue->versions)
+    {
+        for(int i = 0; i < size; i++)
+        {
+            PriorityQueueResult element_result = queueInsert(queue, elements[i], priorities[i], false, NULL);
+            if(results)
+            {
+                results[i] = element_result;
+            }
+            if(result == PQ_SUCCESS)
+            {
+                result = element_result;
+            }
+        }
+        return result;
+    }
+    if(!queueUnshare(queue) || !queueReserve(queue, size))
+    {
+        for(int i = 0; results && i < size; i++)
+        {
+            results[i] = PQ_OUT_OF_MEMORY;
+        }
+        return size > 0 ? PQ_OUT_OF_MEMORY : PQ_SUCCESS;
+    }
+    queueChanged(queue);
+    int first = queue->size;
+    for(int i = 0; i < size; i++)
+    {
+        PriorityQueueResult element_result = PQ_SUCCESS;
+        Node node = NULL;
+        if(!elements[i] || !priorities[i])
+        {
+            element_result = PQ_NULL_ARGUMENT;
+        }
+        else if(!(node = nodeCreate(queue, elements[i], priorities[i])))
+        {
+            element_result = PQ_OUT_OF_MEMORY;
+        }
+        if(node)
+        {
+            node->order = queue->next_order++;
+            nodePlace(queue, node, queue->size);
+            queue->size++;
+        }
+        if(results)
+        {
+            results[i] = element_result;
+        }
+        if(result == PQ_SUCCESS)
+        {
+            result = element_result;
+        }
+    }
+    STATS_ADD(queue, inserts, queue->size - first);
+    STATS_SPAN(queue, insert_scanned, key_comparisons, queueBuildFrom(queue, first));
+    queueUpdatePeak(queue);
+    return result;
+}
+
+
+PriorityQueueResult pqInsertBatch(PriorityQueue queue, PQElement* elements, PQElementPriority* priorities,
+                                  int size, PriorityQueueResult* results)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueInsertBatch(queue, elements, priorities, size, results);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueGetHandle: pqGetHandle, for a queue locked by the caller.
+*/
+static PQHandle queueGetHandle(PriorityQueue queue, PQElement element)
+{
+    if(!queue || !element || !queueUnshare(queue))
+    {
+        return NULL;
+    }
+    int index = queueFind(queue, element, NULL);
+    return index == -1 ? NULL : queue->nodes[index];
+}
+
+
+PQHandle pqGetHandle(PriorityQueue queue, PQElement element)
+{
+    queueLock(queue);
+    PQHandle result = queueGetHandle(queue, element);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueGetHandleByHash: pqGetHandleByHash, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueGetHandleByHash(PriorityQueue queue, unsigned long hash, MatchPQElement match,
+                                                void* context, PQHandle* handle)
+{
+    if(!queue || !match || !handle)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    if(!queue->hash_element)
+    {
+        return PQ_ERROR;
+    }
+    if(!queueUnshare(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    int index = indexFind(queue, hash, match, context);
+    if(index == -1)
+    {
+        return PQ_ELEMENT_DOES_NOT_EXISTS;
+    }
+    *handle = queue->nodes[index];
+    return PQ_SUCCESS;
+}
+
+
+PriorityQueueResult pqGetHandleByHash(PriorityQueue queue, unsigned long hash, MatchPQElement match, void* context,
+                                      PQHandle* handle)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueGetHandleByHash(queue, hash, match, context, handle);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueFindByHash: pqFindByHash, for a queue locked by the caller.
+*/
+static PQElement queueFindByHash(PriorityQueue queue, unsigned long hash, MatchPQElement match, void* context)
+{
+    if(!queue || !match || !queue->hash_element)
+    {
+        return NULL;
+    }
+    int index = indexFind(queue, hash, match, context);
+    return index == -1 ? NULL : queue->nodes[index]->element;
+}
+
+
+PQElement pqFindByHash(PriorityQueue queue, unsigned long hash, MatchPQElement match, void* context)
+{
+    queueLock(queue);
+    PQElement result = queueFindByHash(queue, hash, match, context);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueGetElementByHandle: pqGetElementByHandle, for a queue locked by the caller.
+*/
+static PQElement queueGetElementByHandle(PriorityQueue queue, PQHandle handle)
+{
+    if(!queue || !handle || !nodeIsInQueue(queue, handle))
+    {
+        return NULL;
+    }
+    return handle->element;
+}
+
+
+PQElement pqGetElementByHandle(PriorityQueue queue, PQHandle handle)
+{
+    queueLock(queue);
+    PQElement result = queueGetElementByHandle(queue, handle);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueGetPriorityByHandle: pqGetPriorityByHandle, for a queue locked by the caller.
+*/
+static PQElementPriority queueGetPriorityByHandle(PriorityQueue queue, PQHandle handle)
+{
+    if(!queue || !handle || !nodeIsInQueue(queue, handle))
+    {
+        return NULL;
+    }
+    return handle->priority;
+}
+
+
+PQElementPriority pqGetPriorityByHandle(PriorityQueue queue, PQHandle handle)
+{
+    queueLock(queue);
+    PQElementPriority result = queueGetPriorityByHandle(queue, handle);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueChangePriorityByHandle: pqChangePriorityByHandle, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueChangePriorityByHandle(PriorityQueue queue, PQHandle handle, PQElementPriority new_priority)
+{
+    if(!queue || !handle || !new_priority)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    if(!queueUnshare(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    if(!nodeIsInQueue(queue, handle))
+    {
+        return PQ_ELEMENT_DOES_NOT_EXISTS;
+    }
+    PQElementPriority priority = keyCopy(queue, new_priority);
+    if(!priority)
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueChanged(queue);
+    if(!nodeSetPriority(queue, handle, priority))
+    {
+        keyFree(queue, priority);
+        return PQ_OUT_OF_MEMORY;
+    }
+    return PQ_SUCCESS;
+}
+
+
+PriorityQueueResult pqChangePriorityByHandle(PriorityQueue queue, PQHandle handle, PQElementPriority new_priority)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueChangePriorityByHandle(queue, handle, new_priority);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueRemoveByHandle: pqRemoveByHandle, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueRemoveByHandle(PriorityQueue queue, PQHandle handle)
+{
+    if(!queue || !handle)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    if(!queueUnshare(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    if(!nodeIsInQueue(queue, handle))
+    {
+        return PQ_ELEMENT_DOES_NOT_EXISTS;
+    }
+    if(!versionsRemove(queue, handle))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueChanged(queue);
+    queueErase(queue, handle);
+    return PQ_SUCCESS;
+}
+
+
+PriorityQueueResult pqRemoveByHandle(PriorityQueue queue, PQHandle handle)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueRemoveByHandle(queue, handle);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueCompactAll: pqCompact, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueCompactAll(PriorityQueue queue)
+{
+    if(!queue)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    queue->iterator = INVALID_ITERATOR;
+    queueCompact(queue);
+    return PQ_SUCCESS;
+}
+
+
+PriorityQueueResult pqCompact(PriorityQueue queue)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueCompactAll(queue);
+    queueUnlock(queue);
+    return result;
+}
+
+
+PriorityQueueResult pqChangePriority(PriorityQueue queue, PQElement element,
+                                     PQElementPriority old_priority, PQElementPriority new_priority)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueChangePriority(queue, element, old_priority, new_priority, false);
+    queueUnlock(queue);
+    return result;
+}
+
+
+PriorityQueueResult pqChangePriorityOwned(PriorityQueue queue, PQElement element,
+                                          PQElementPriority old_priority, PQElementPriority new_priority)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueChangePriority(queue, element, old_priority, new_priority, true);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueRemove: pqRemove, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueRemove(PriorityQueue queue)
+{
+    if(!queue)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    if(!queueUnshare(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueChanged(queue);
+    if(queue->size == 0)
+    {
+        return PQ_SUCCESS;
+    }
+    if(!versionsRemove(queue, queueFirst(queue)))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueDiscard(queue, queueDetach(queue, queueFirst(queue)));
+    return PQ_SUCCESS;
+}
+
+
+PriorityQueueResult pqRemove(PriorityQueue queue)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueRemove(queue);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueExtractCopy: Removes the first node of a queue which has snapshots, and returns copies of its element
+*           and priority, since the snapshots may still see the originals. The node is retired.
+*
+* @param queue - Target persistent queue, which is not empty.
+* @param element - Pointer to assign the copy of the element into.
+* @param priority - Pointer to assign the copy of the priority into, or NULL.
+* @param key - A copy of an inline key to assign into priority, or NULL.
+* @return
+* 	PQ_OUT_OF_MEMORY if an allocation failed, key is freed and the queue is not changed.
+* 	PQ_SUCCESS the element was removed and its copy returned.
+*/
+static PriorityQueueResult queueExtractCopy(PriorityQueue queue, PQElement* element, PQElementPriority* priority,
+                                            PQElementPriority key)
+{
+    Node node = queueFirst(queue);
+    PQElement element_copy = queue->copy_element(node->element);
+    PQElementPriority priority_copy = priority && !key ? queue->copy_priority(node->priority) : key;
+    STATS_ADD(queue, element_copies, 1);
+    STATS_ADD(queue, priority_copies, priority && !key ? 1 : 0);
+    if(!element_copy || (priority && !priority_copy) || !versionsRemove(queue, node))
+    {
+        if(element_copy)
+        {
+            queue->free_element(element_copy);
+        }
+        if(priority_copy && !key)
+        {
+            queue->free_priority(priority_copy);
+        }
+        free(key);
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueChanged(queue);
+    queueDiscard(queue, queueDetach(queue, node));
+    *element = element_copy;
+    if(priority)
+    {
+        *priority = priority_copy;
+    }
+    return PQ_SUCCESS;
+}
+
+/**
+* queueExtract: pqExtract, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueExtract(PriorityQueue queue, PQElement* element, PQElementPriority* priority)
+{
+    if(!queue || !element)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    *element = NULL;
+    if(priority)
+    {
+        *priority = NULL;
+    }
+    if(queue->size == 0)
+    {
+        return PQ_ELEMENT_DOES_NOT_EXISTS;
+    }
+    if(!queueUnshare(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    Node node = queueFirst(queue);
+    PQElementPriority key = NULL;
+    if(priority && keyIsInline(queue))
+    {
+        key = malloc(queue->key_size);
+        if(!key)
+        {
+            return PQ_OUT_OF_MEMORY;
+        }
+        memcpy(key, node->priority, queue->key_size);
+    }
+    if(queueIsPinned(queue))
+    {
+        return queueExtractCopy(queue, element, priority, key);
+    }
+    if(!versionsRemove(queue, node))
+    {
+        free(key);
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueChanged(queue);
+    queueDetach(queue, node);
+    queueCount(queue, node->element, node->priority, false);
+    *element = node->element;
+    if(priority)
+    {
+        *priority = key ? key : node->priority;
+    }
+    else
+    {
+        keyFree(queue, node->priority);
+    }
+    poolFree(queue->pool, node);
+    return PQ_SUCCESS;
+}
+
+
+PriorityQueueResult pqExtract(PriorityQueue queue, PQElement* element, PQElementPriority* priority)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueExtract(queue, element, priority);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueRemoveElement: pqRemoveElement, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueRemoveElement(PriorityQueue queue, PQElement element)
+{
+    if(!queue || !element)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    if(!queueUnshare(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueChanged(queue);
+    int index = -1;
+    STATS_ADD(queue, removes, 1);
+    STATS_SPAN(queue, remove_scanned, equal_calls, index = queueFind(queue, element, NULL));
+    if(index == -1)
+    {
+        return PQ_ELEMENT_DOES_NOT_EXISTS;
+    }
+    if(!versionsRemove(queue, queue->nodes[index]))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueErase(queue, queue->nodes[index]);
+    return PQ_SUCCESS;
+}
+
+
+PriorityQueueResult pqRemoveElement(PriorityQueue queue, PQElement element)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueRemoveElement(queue, element);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queuePopWhile: pqPopWhile, for a queue locked by the caller.
+*/
+static PriorityQueueResult queuePopWhile(PriorityQueue queue, PQPredicate predicate, void* context,
+                                         PQElementCallback callback)
+{
+    if(!queue || !predicate)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    if(!queueUnshare(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueChanged(queue);
+    while(queue->size > 0)
+    {
+        Node node = queueFirst(queue);
+        if(!predicate(node->element, node->priority, context))
+        {
+            break;
+        }
+        if(!versionsRemove(queue, node))
+        {
+            return PQ_OUT_OF_MEMORY;
+        }
+        queueDetach(queue, node);
+        if(callback)
+        {
+            callback(node->element, node->priority, context);
+        }
+        queueDiscard(queue, node);
+    }
+    return PQ_SUCCESS;
+}
+
+
+PriorityQueueResult pqPopWhile(PriorityQueue queue, PQPredicate predicate, void* context,
+                               PQElementCallback callback)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queuePopWhile(queue, predicate, context, callback);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueGetFirst: pqGetFirst, for a queue locked by the caller.
+*/
+static PQElement queueGetFirst(PriorityQueue queue)
+{
+    if(!queue || queue->size == 0)
+    {
+        return NULL;
+    }
+    queue->iterator = 0;
+    queue->iterator_generation = queue->generation;
+    return queueFirst(queue)->element;
+
+}
+
+
+PQElement pqGetFirst(PriorityQueue queue)
+{
+    queueLock(queue);
+    PQElement result = queueGetFirst(queue);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueGetNext: pqGetNext, for a queue locked by the caller.
+*/
+static PQElement queueGetNext(PriorityQueue queue)
+{
+    if(!queue || !queueIteratorIsValid(queue))
+    {
+        return NULL;
+    }
+    if(!queueSort(queue))
+    {
+        queue->iterator = INVALID_ITERATOR;
+        return NULL;
+    }
+    Node* sorted = queue->backend->sorted ? queue->nodes : queue->sorted;
+    do
+    {
+        queue->iterator++;
+    } while(queue->iterator < queue->size && !sorted[queue->iterator]->element);
+    if(queue->iterator >= queue->size)
+    {
+        queue->iterator = INVALID_ITERATOR;
+        return NULL;
+    }
+    return sorted[queue->iterator]->element;
+}
+
+
+PQElement pqGetNext(PriorityQueue queue)
+{
+    queueLock(queue);
+    PQElement result = queueGetNext(queue);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queuePeekK: pqPeekK, for a queue locked by the caller. The sorted array is used if it is up to date,
+*           and otherwise the backend selects the first nodes.
+*/
+static int queuePeekK(PriorityQueue queue, int k, PQElement* out_elements, PQElementPriority* out_priorities)
+{
+    if(!queue || !out_elements || k < 0)
+    {
+        return -1;
+    }
+    if(k > queue->size - queue->dead)
+    {
+        k = queue->size - queue->dead;
+    }
+    if(k == 0)
+    {
+        return 0;
+    }
+    int count = k + queue->dead < queue->size ? k + queue->dead : queue->size;
+    Node* selected = NULL;
+    Node* nodes = queue->backend->sorted ? queue->nodes : queue->sorted;
+    if(!queue->backend->sorted && queue->sorted_generation != queue->generation)
+    {
+        selected = malloc(count * sizeof(*selected));
+        if(!selected || !queue->backend->peek(queue, selected, count))
+        {
+            free(selected);
+            return -1;
+        }
+        nodes = selected;
+    }
+    for(int i = 0, found = 0; found < k; i++)
+    {
+        if(!nodes[i]->element)
+        {
+            continue;
+        }
+        out_elements[found] = nodes[i]->element;
+        if(out_priorities)
+        {
+            out_priorities[found] = nodes[i]->priority;
+        }
+        found++;
+    }
+    free(selected);
+    return k;
+}
+
+
+int pqPeekK(PriorityQueue queue, int k, PQElement* out_elements, PQElementPriority* out_priorities)
+{
+    queueLock(queue);
+    int result = queuePeekK(queue, k, out_elements, out_priorities);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueForEachInRange: pqForEachInRange, for a queue locked by the caller. The skip list backend finds the
+*           start of the range in its levels, and the other backends search the sorted array for it.
+*/
+static PriorityQueueResult queueForEachInRange(PriorityQueue queue, PQElementPriority lo, PQElementPriority hi,
+                                               PQElementCallback callback, void* context)
+{
+    if(!queue || !lo || !hi || !callback)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    PQElementPriority start = keyCompare(queue, lo, hi) >= 0 ? lo : hi;
+    PQElementPriority end = start == lo ? hi : lo;
+    if(queue->backend_type == PQ_BACKEND_SKIP_LIST)
+    {
+        Node node = skipListSeek(queue, NULL, start, NULL);
+        for(node = node ? nodeLinks(node)->next : queue->skip_list->first;
+            node && keyCompare(queue, node->priority, end) >= 0; node = nodeLinks(node)->next)
+        {
+            if(node->element)
+            {
+                callback(node->element, node->priority, context);
+            }
+        }
+        return PQ_SUCCESS;
+    }
+    if(queue->key_array)
+    {
+        int low = keyArrayRank(queue->key_array, queue->size, keyArrayKey(queue, start), false);
+        int high = keyArrayRank(queue->key_array, queue->size, keyArrayKey(queue, end), true);
+        for(int i = low; i < high; i++)
+        {
+            if(queue->nodes[i]->element)
+            {
+                callback(queue->nodes[i]->element, queue->nodes[i]->priority, context);
+            }
+        }
+        return PQ_SUCCESS;
+    }
+    if(!queueSort(queue))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    Node* sorted = queue->backend->sorted ? queue->nodes : queue->sorted;
+    int low = 0;
+    int high = queue->size;
+    while(low < high)
+    {
+        int middle = low + (high - low) / 2;
+        if(keyCompare(queue, sorted[middle]->priority, start) > 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    for(int i = low; i < queue->size && keyCompare(queue, sorted[i]->priority, end) >= 0; i++)
+    {
+        if(sorted[i]->element)
+        {
+            callback(sorted[i]->element, sorted[i]->priority, context);
+        }
+    }
+    return PQ_SUCCESS;
+}
 
-#include <stdbool.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <assert.h>
-#include "priority_queue.h"
 
-/** Type for defining Node to the priority queue */
-typedef struct Node_t *Node;
+PriorityQueueResult pqForEachInRange(PriorityQueue queue, PQElementPriority lo, PQElementPriority hi,
+                                     PQElementCallback fn, void* ctx)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueForEachInRange(queue, lo, hi, fn, ctx);
+    queueUnlock(queue);
+    return result;
+}
 
-/** Auxiliary struct for PrioretyQueue - Linked List */
-struct Node_t {
-    PQElement element;
-    PQElementPriority priority;
-    struct Node_t* next;
-};
 
-/** Struct representing Generic Priorety Queue */
-struct PriorityQueue_t {
-    Node head;
-    CopyPQElement copy_element;
-    FreePQElement free_element;
-    EqualPQElements equal_elements;
-    CopyPQElementPriority copy_priority;
-    FreePQElementPriority free_priority;
-    ComparePQElementPriorities compare_priorities;
-    Node iterator;
-};
+PQIterator pqIterBegin(PriorityQueue queue)
+{
+    queueLock(queue);
+    PQIterator result = queueIterBegin(queue);
+    queueUnlock(queue);
+    return result;
+}
 
-/**
-* nodeCreate: Allocates a new node element.
-* 
-* @param element - a PQElement to be held by the new node element
-* @param priorety - a PQElementPriorety to be held by the new node element
-* @param copy_element - Function pointer to be used for copying data elements into
-*  	the new node element or when copying the new node element.
-* @param free_element - Function pointer to be used for removing data elements from
-* 		the new node element
-* @param compare_element - Function pointer to be used for comparing elements
-* 		inside the new node element. Used to check if new elements already exist in the new node element.
-* @param copy_priority - Function pointer to be used for copying priority into
-*  	the new node element or when copying the new node element.
-* @param free_priority - Function pointer to be used for removing priority from
-* 		the new node element
-* @param compare_priority - Function pointer to be used for comparing elements
-* 		inside the new node element. Used to check if new elements already exist in the new node element.
-* @return
-* 	NULL - if one of the parameters is NULL or allocations failed.
-* 	A new Node in case of success.
-*/
-static Node nodeCreate( PQElement element,
-                        PQElementPriority priority,
-                        CopyPQElement copy_element,
-                        CopyPQElementPriority copy_priority,
-                        FreePQElementPriority free_priority,
-                        FreePQElement free_element)
+
+PQElement pqIterNext(PQIterator iterator)
 {
-    if(!element || !priority || !copy_priority || !copy_element || !free_element || !free_priority)
+    if(!iterator || iterator->position >= iterator->size)
     {
         return NULL;
     }
-    Node node = malloc(sizeof(*node));
-    if(!node)
+    PQElement element = NULL;
+    queueLock(iterator->queue);
+    if(iterator->generation == iterator->queue->generation)
     {
-        return NULL;
+        element = iterator->nodes[iterator->position++]->element;
     }
-    PQElement new_element = copy_element(element);
-    if(!new_element)
+    else
     {
-        free(node);
-        return NULL;
+        iterator->position = iterator->size;
     }
-    PQElementPriority new_priorety = copy_priority(priority);
-    if(!new_priorety)
-    {
-        free(node);
-        free_element(new_element);
-        return NULL;
+    queueUnlock(iterator->queue);
+    return element;
+}
 
-    }
-    node->element = new_element;
-    node->priority = new_priorety;
-    node->next = NULL;
-    return node;
+
+void pqIterEnd(PQIterator iterator)
+{
+    free(iterator);
 }
 
 
-PriorityQueue pqCreate(CopyPQElement copy_element,
-                       FreePQElement free_element,
-                       EqualPQElements equal_elements,
-                       CopyPQElementPriority copy_priority,
-                       FreePQElementPriority free_priority,
-                       ComparePQElementPriorities compare_priorities)
+/**
+* queueSnapshot: pqSnapshot, for a queue locked by the caller.
+*/
+static PQSnapshot queueSnapshot(PriorityQueue queue)
 {
-    if(!copy_element || !free_element || !equal_elements || !copy_priority || !free_priority || !compare_priorities)
+    if(!queue || !queue->versions)
     {
         return NULL;
     }
-    PriorityQueue queue = malloc(sizeof(*queue));
-    if(!queue)
+    PQSnapshot snapshot = malloc(sizeof(*snapshot));
+    if(!snapshot)
     {
         return NULL;
-    }    
-    queue->head = NULL;
-    queue->copy_element = copy_element;
-    queue->free_element = free_element;
-    queue->equal_elements = equal_elements;
-    queue->copy_priority = copy_priority;
-    queue->free_priority = free_priority;
-    queue->compare_priorities = compare_priorities;
-    return queue;
+    }
+    Versions versions = queue->versions;
+    snapshot->queue = queue;
+    snapshot->root = versions->root;
+    if(snapshot->root)
+    {
+        snapshot->root->ref_count++;
+    }
+    snapshot->size = queue->size;
+    snapshot->sequence = ++versions->sequence;
+    snapshot->older = versions->newest;
+    snapshot->newer = NULL;
+    if(versions->newest)
+    {
+        versions->newest->newer = snapshot;
+    }
+    else
+    {
+        versions->oldest = snapshot;
+    }
+    versions->newest = snapshot;
+    return snapshot;
 }
 
 
-void pqDestroy(PriorityQueue queue)
+PQSnapshot pqSnapshot(PriorityQueue queue)
 {
-    if(!queue)
+    queueLock(queue);
+    PQSnapshot result = queueSnapshot(queue);
+    queueUnlock(queue);
+    return result;
+}
+
+
+void pqRelease(PQSnapshot snapshot)
+{
+    if(!snapshot)
     {
         return;
     }
-    while(queue->head)
+    PriorityQueue queue = snapshot->queue;
+    queueLock(queue);
+    Versions versions = queue->versions;
+    if(snapshot->older)
     {
-        Node to_delete = queue->head;
-        queue->free_element(to_delete->element);
-        queue->free_priority(to_delete->priority);
-        queue->head = to_delete->next;
-        free(to_delete);
+        snapshot->older->newer = snapshot->newer;
     }
-    free(queue);
+    else
+    {
+        versions->oldest = snapshot->newer;
+    }
+    if(snapshot->newer)
+    {
+        snapshot->newer->older = snapshot->older;
+    }
+    else
+    {
+        versions->newest = snapshot->older;
+    }
+    versionEntryRelease(queue, snapshot->root);
+    versionsCollect(queue);
+    queueUnlock(queue);
+    free(snapshot);
 }
 
 
-PriorityQueue pqCopy(PriorityQueue queue)
+int pqSnapshotGetSize(PQSnapshot snapshot)
 {
-    if(!queue)
+    if(!snapshot)
     {
-        return NULL;
+        return -1;
     }
-    PriorityQueue new_queue = pqCreate( queue->copy_element,
-                                        queue->free_element,
-                                        queue->equal_elements,
-                                        queue->copy_priority,
-                                        queue->free_priority,
-                                        queue->compare_priorities);
-    if(!new_queue)
+    return snapshot->size;
+}
+
+
+PriorityQueueResult pqSnapshotForEach(PQSnapshot snapshot, PQElementCallback fn, void* ctx)
+{
+    if(!snapshot || !fn)
     {
-        return NULL;
+        return PQ_NULL_ARGUMENT;
     }
-    Node new_head = nodeCreate( queue->head->element, 
-                                queue->head->priority, 
-                                queue->copy_element, 
-                                queue->copy_priority, 
-                                queue->free_priority, 
-                                queue->free_element);
-    if(!new_head)
+    versionForEach(snapshot->root, fn, ctx);
+    return PQ_SUCCESS;
+}
+
+
+PriorityQueueResult pqClear(PriorityQueue queue)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueClear(queue);
+    queueUnlock(queue);
+    return result;
+}
+
+
+PQNodePool pqNodePoolCreate()
+{
+    PQNodePool pool = malloc(sizeof(*pool));
+    if(!pool)
     {
-        pqDestroy(new_queue);
         return NULL;
     }
-    new_queue->head = new_head;
-    Node head_ptr = queue->head->next;
-    Node new_head_ptr = new_queue->head;
-    while(head_ptr)
+    pool->node_units = 0;
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pool->slab_used = 0;
+    pool->next_slab_capacity = INITIAL_SLAB_NODES;
+    pool->capacity = 0;
+    pool->used = 0;
+    pool->high_water_mark = 0;
+    pool->ref_count = 1;
+    return pool;
+}
+
+
+void pqNodePoolDestroy(PQNodePool pool)
+{
+    if(!pool)
+    {
+        return;
+    }
+    pool->ref_count--;
+    if(pool->ref_count > 0)
     {
-        Node node = nodeCreate( head_ptr->element, 
-                                head_ptr->priority,                          
-                                queue->copy_element, 
-                                queue->copy_priority, 
-                                queue->free_priority, 
-                                queue->free_element);
-        if(!node)
-        {
-            pqDestroy(new_queue);
-            return NULL;
-        }
-        new_head_ptr->next = node;
-        new_head_ptr = new_head_ptr->next;
-        head_ptr = head_ptr->next;
+        return;
     }
-    new_queue->iterator = NULL;
-    queue->iterator = NULL;
-    return new_queue;
+    poolRelease(pool);
+    free(pool);
 }
 
 
-int pqGetSize(PriorityQueue queue)
+int pqNodePoolGetCapacity(PQNodePool pool)
 {
-    if(!queue)
+    if(!pool)
     {
         return -1;
     }
-    Node head_ptr = queue->head;
-    int counter = 0;
-    while(head_ptr)
+    return pool->capacity;
+}
+
+
+int pqNodePoolGetHighWaterMark(PQNodePool pool)
+{
+    if(!pool)
     {
-        head_ptr = head_ptr->next;
-        counter++;
+        return -1;
     }
-    return counter;
+    return pool->high_water_mark;
 }
 
 
-bool pqContains(PriorityQueue queue, PQElement element)
+/**
+* poolBytes: Returns the size of a number of nodes of a node pool.
+*
+* @param pool - The node pool.
+* @param count - The number of nodes.
+* @return
+* 	The number of bytes.
+*/
+static size_t poolBytes(PQNodePool pool, int count)
 {
-    if(!queue || !element)
+    return (size_t)count * pool->node_units * sizeof(Unit);
+}
+
+/**
+* queueStructureBytes: Returns the memory held by the structures of a queue - everything but its nodes,
+*           elements and priorities.
+*
+* @param queue - Target priority queue.
+* @return
+* 	The number of bytes.
+*/
+static size_t queueStructureBytes(PriorityQueue queue)
+{
+    size_t bytes = sizeof(*queue) + (size_t)queue->capacity * sizeof(*queue->nodes);
+    if(queue->sorted)
     {
-        return false;
+        bytes += (size_t)queue->capacity * sizeof(*queue->sorted);
     }
-    Node head_ptr = queue->head;
-    while(head_ptr)
+    bytes += (size_t)queue->index_capacity * sizeof(*queue->index);
+    if(queue->calendar)
     {
-        if(queue->equal_elements(head_ptr->element, element))
-        {
-            return true;
-        }
-        head_ptr = head_ptr->next;
+        bytes += sizeof(*queue->calendar) + (size_t)queue->calendar->bucket_count * sizeof(Node);
     }
-    return false;
+    if(queue->key_array)
+    {
+        bytes += sizeof(*queue->key_array) + (size_t)queue->key_array->capacity * sizeof(int64_t) +
+                 KEY_ARRAY_ALIGNMENT - 1;
+    }
+    if(queue->skip_list)
+    {
+        bytes += sizeof(*queue->skip_list) + poolBytes(queue->skip_list->index_pool,
+                                                       queue->skip_list->index_pool->capacity);
+    }
+    if(queue->versions)
+    {
+        bytes += sizeof(*queue->versions) + poolBytes(queue->versions->entry_pool,
+                                                      queue->versions->entry_pool->capacity);
+        bytes += (size_t)queue->versions->retired_capacity * sizeof(Node);
+    }
+    if(queue->lock)
+    {
+        bytes += sizeof(*queue->lock);
+    }
+    return bytes;
+}
+
+/**
+* queueGetMemoryStats: pqGetMemoryStats, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueGetMemoryStats(PriorityQueue queue, PQMemoryStats* stats)
+{
+    if(!queue || !stats)
+    {
+        return PQ_NULL_ARGUMENT;
+    }
+    stats->element_bytes = queue->element_bytes;
+    stats->priority_bytes = queue->priority_bytes;
+    stats->node_bytes = queueUsage(queue) - queue->element_bytes - queue->priority_bytes;
+    stats->structure_bytes = queueStructureBytes(queue);
+    stats->slack_bytes = poolBytes(queue->pool, queue->pool->capacity - queue->pool->used);
+    stats->total_bytes = stats->node_bytes + stats->element_bytes + stats->priority_bytes +
+                         stats->structure_bytes + stats->slack_bytes;
+    stats->peak_bytes = queue->peak_bytes;
+    return PQ_SUCCESS;
 }
 
 
-PriorityQueueResult pqInsert(PriorityQueue queue, PQElement element, PQElementPriority priority)
+PriorityQueueResult pqGetMemoryStats(PriorityQueue queue, PQMemoryStats* stats)
 {
-    if(!queue || !element || !priority)
+    queueLock(queue);
+    PriorityQueueResult result = queueGetMemoryStats(queue, stats);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueGetOpStats: pqGetOpStats, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueGetOpStats(PriorityQueue queue, PQOpStats* stats)
+{
+    if(!queue || !stats)
     {
         return PQ_NULL_ARGUMENT;
     }
-    queue->iterator = NULL;
-    Node to_add = nodeCreate(   element, 
-                                priority,
-                                queue->copy_element, 
-                                queue->copy_priority, 
-                                queue->free_priority, 
-                                queue->free_element);
-    if(!to_add)
+#ifdef PQ_STATS
+    *stats = queue->op_stats;
+    return PQ_SUCCESS;
+#else
+    return PQ_ERROR;
+#endif
+}
+
+
+PriorityQueueResult pqGetOpStats(PriorityQueue queue, PQOpStats* stats)
+{
+    queueLock(queue);
+    PriorityQueueResult result = queueGetOpStats(queue, stats);
+    queueUnlock(queue);
+    return result;
+}
+
+
+PQNodePool pqGetNodePool(PriorityQueue queue)
+{
+    if(!queue)
     {
-        return PQ_OUT_OF_MEMORY;
+        return NULL;
     }
-    if(!(queue->head))
+    return queue->pool;
+}
+
+
+/**
+* queueSetNodePool: pqSetNodePool, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueSetNodePool(PriorityQueue queue, PQNodePool pool)
+{
+    if(!queue || !pool)
     {
-        queue->head = to_add;
-        return PQ_SUCCESS;
+        return PQ_NULL_ARGUMENT;
     }
-    if(queue->compare_priorities(queue->head->priority, to_add->priority) < 0)
+    int node_units = queueNodeUnits(queue);
+    if(queue->size > 0 || queueIsPinned(queue) || (pool->node_units != 0 && pool->node_units != node_units))
     {
-        to_add->next = queue->head;
-        queue->head = to_add;
-        return PQ_SUCCESS;
+        return PQ_ERROR;
     }
-    Node temp_head = queue->head;
-    while((temp_head->next) && queue->compare_priorities(temp_head->next->priority, to_add->priority) >= 0)
+    if(!queueUnshare(queue))
     {
-        temp_head = temp_head->next;
+        return PQ_OUT_OF_MEMORY;
     }
-    to_add->next = temp_head->next;
-    temp_head->next = to_add;
+    pool->node_units = node_units;
+    pool->ref_count++;
+    pqNodePoolDestroy(queue->pool);
+    queue->pool = pool;
     return PQ_SUCCESS;
 }
 
 
-PriorityQueueResult pqChangePriority(PriorityQueue queue, PQElement element,
-                                     PQElementPriority old_priority, PQElementPriority new_priority)
+PriorityQueueResult pqSetNodePool(PriorityQueue queue, PQNodePool pool)
 {
-    if(!queue || !element || !old_priority || !new_priority)
+    queueLock(queue);
+    PriorityQueueResult result = queueSetNodePool(queue, pool);
+    queueUnlock(queue);
+    return result;
+}
+
+
+/**
+* queueMerge: pqMerge, for queues locked by the caller.
+*/
+static PriorityQueueResult queueMerge(PriorityQueue destination, PriorityQueue source)
+{
+    if(!destination || !source)
     {
         return PQ_NULL_ARGUMENT;
     }
-    queue->iterator = NULL;
-    if( queue->compare_priorities(old_priority, queue->head->priority) == 0 &&
-        queue->equal_elements(element, queue->head->element))
+    if(destination == source || !queueHasSameFunctions(destination, source) || queueIsPinned(source))
     {
-        Node head_ptr = queue->head->next;
-        queue->free_element(queue->head->element);
-        queue->free_priority(queue->head->priority);
-        free(queue->head);
-        queue->head = head_ptr;
+        return PQ_ERROR;
     }
-    else
+    if(!queueUnshare(destination) || !queueUnshare(source))
+    {
+        return PQ_OUT_OF_MEMORY;
+    }
+    queueCompact(destination);
+    queueCompact(source);
+    VersionEntry root = NULL;
+    if(!queueReserve(destination, source->size) || (destination->versions && !versionsMerge(destination, source, &root)))
     {
-        Node head_ptr = queue->head;
-        while(head_ptr->next)
+        return PQ_OUT_OF_MEMORY;
+    }
+    int first = destination->size;
+    for(int i = 0; i < source->size; i++)
+    {
+        Node node = source->nodes[i];
+        if(destination->pool != source->pool)
         {
-            if( queue->equal_elements(element, head_ptr->next->element) && 
-                queue->compare_priorities(old_priority, head_ptr->next->priority) == 0)
+            Node moved = poolAllocate(destination->pool);
+            STATS_ADD(destination, node_allocations, moved ? 1 : 0);
+            if(!moved)
             {
-                break;
+                for(int j = first; j < destination->size; j++)
+                {
+                    poolFree(destination->pool, destination->nodes[j]);
+                }
+                destination->size = first;
+                versionEntryRelease(destination, root);
+                return PQ_OUT_OF_MEMORY;
             }
-            head_ptr = head_ptr->next;
+            *moved = *node;
+            nodeSetKey(destination, moved, node->priority);
+            node = moved;
         }
-        if(!head_ptr->next)
+        node->order += destination->next_order;
+        nodePlace(destination, node, destination->size);
+        destination->size++;
+    }
+    for(int i = first; i < destination->size; i++)
+    {
+        queueCount(source, destination->nodes[i]->element, destination->nodes[i]->priority, false);
+        queueCount(destination, destination->nodes[i]->element, destination->nodes[i]->priority, true);
+    }
+    for(int i = 0; i < source->size; i++)
+    {
+        if(destination->pool != source->pool)
         {
-            return PQ_ELEMENT_DOES_NOT_EXISTS;
+            poolFree(source->pool, source->nodes[i]);
         }
-        Node to_delete = head_ptr->next;
-        queue->free_element(to_delete->element);
-        queue->free_priority(to_delete->priority);
-        head_ptr->next = to_delete->next;
-        free(to_delete);
     }
-    return (pqInsert(queue, element, new_priority) == PQ_SUCCESS) ? PQ_SUCCESS : PQ_OUT_OF_MEMORY;
-}
-
-
-PriorityQueueResult pqRemove(PriorityQueue queue)
-{
-    if(!queue)
+    destination->next_order += source->next_order;
+    queueBuildFrom(destination, first);
+    for(int i = 0; i < source->index_capacity; i++)
     {
-        return PQ_NULL_ARGUMENT;
+        source->index[i] = NULL;
     }
-    queue->iterator = NULL;
-    Node to_remove = queue->head;
-    if(!queue->head)
+    source->size = 0;
+    source->backend->build(source);
+    queueUpdatePeak(destination);
+    if(destination->versions)
     {
-        return PQ_SUCCESS;
+        versionsCommit(destination, root);
     }
-    queue->head = to_remove->next;
-    queue->free_element(to_remove->element);
-    queue->free_priority(to_remove->priority);
-    free(to_remove);
+    if(source->versions)
+    {
+        versionsCommit(source, NULL);
+    }
+    queueChanged(destination);
+    queueChanged(source);
     return PQ_SUCCESS;
 }
 
 
-PriorityQueueResult pqRemoveElement(PriorityQueue queue, PQElement element)
+PriorityQueueResult pqMerge(PriorityQueue destination, PriorityQueue source)
 {
-    if(!queue || !element)
+    if(!destination || !source)
     {
         return PQ_NULL_ARGUMENT;
     }
-    queue->iterator = NULL;
-    Node temp_head = queue->head;
-    if(queue->equal_elements(queue->head->element, element))
-    {
-        return pqRemove(queue);
-    }
-    while(temp_head->next && !queue->equal_elements(element, temp_head->next->element))
+    queueLockPair(destination, source);
+    PriorityQueueResult result = queueMerge(destination, source);
+    queueUnlockPair(destination, source);
+    return result;
+}
+
+
+/**
+* queueSetCopyOnWrite: pqSetCopyOnWrite, for a queue locked by the caller.
+*/
+static PriorityQueueResult queueSetCopyOnWrite(PriorityQueue queue, bool copy_on_write)
+{
+    if(!queue)
     {
-        temp_head = temp_head->next;
+        return PQ_NULL_ARGUMENT;
     }
-    if(!temp_head->next)
+    if(copy_on_write && queue->versions)
     {
-        return PQ_ELEMENT_DOES_NOT_EXISTS;
+        return PQ_ERROR;
     }
-    Node to_delete = temp_head->next;
-    queue->free_element(to_delete->element);
-    queue->free_priority(to_delete->priority);
-    temp_head->next = to_delete->next;
-    free(to_delete);
+    queue->copy_on_write = copy_on_write;
     return PQ_SUCCESS;
 }
 
 
-PQElement pqGetFirst(PriorityQueue queue)
+PriorityQueueResult pqSetCopyOnWrite(PriorityQueue queue, bool copy_on_write)
 {
-    if(!queue || pqGetSize(queue)==0)
-    {
-        return NULL;
-    }
-    queue->iterator = queue->head;
-    return queue->head->element;
-
+    queueLock(queue);
+    PriorityQueueResult result = queueSetCopyOnWrite(queue, copy_on_write);
+    queueUnlock(queue);
+    return result;
 }
 
 
-PQElement pqGetNext(PriorityQueue queue)
+PriorityQueueResult pqSetBackend(PriorityQueue queue, PQBackendType backend)
 {
-    if(!queue || pqGetSize(queue)==0 || !(queue->iterator) || !(queue->iterator->next))
+    if(!queue)
     {
-        return NULL;
+        return PQ_NULL_ARGUMENT;
     }
-    queue->iterator = queue->iterator->next;
-    return queue->iterator->element;
+    queueLock(queue);
+    PriorityQueueResult result = PQ_ERROR;
+    if(backendIsValid(backend, queue->key_type) && queue->size == 0)
+    {
+        result = queueUnshare(queue) ? queueSetBackend(queue, backend, DEFAULT_ARITY) : PQ_OUT_OF_MEMORY;
+    }
+    queueUnlock(queue);
+    return result;
 }
 
 
-PriorityQueueResult pqClear(PriorityQueue queue)
+int pqCompareFirst(PriorityQueue queue1, PriorityQueue queue2)
 {
-    if(!queue)
+    if(!queue1 || !queue2 || queue1 == queue2)
     {
-        return PQ_NULL_ARGUMENT;
+        return 0;
     }
-    while(queue->head)
+    queueLockPair(queue1, queue2);
+    int result = (queue1->size > 0) - (queue2->size > 0);
+    if(queue1->size > 0 && queue2->size > 0)
     {
-        Node temp_head = queue->head->next;
-        queue->free_element(queue->head->element);
-        queue->free_priority(queue->head->priority);
-        free(queue->head);
-        queue->head = temp_head;
+        result = keyCompare(queue1, queueFirst(queue1)->priority, queueFirst(queue2)->priority);
     }
-    return PQ_SUCCESS;
-}
\ No newline at end of file
+    queueUnlockPair(queue1, queue2);
+    return result;
+}
+
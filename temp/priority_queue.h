@@ -2,6 +2,8 @@
 #define PRIORITY_QUEUE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /**
 * Generic Priority Queue Container
@@ -11,29 +13,121 @@
 * where the state of the iterator after calling that function is not stated,
 * it is undefined. That means that you cannot assume anything about it.
 *
+* A priority queue created with the concurrent option of pqCreateEx can be used by several threads
+* at once. Every function holds the lock of the priority queue while it runs, so each call takes
+* effect at once, as if the calls were made one after the other. Since the internal iterator is shared
+* by all threads, a thread should iterate over a snapshot - a copy made by pqCopy of a priority queue in
+* copy-on-write mode, which is created in O(1) and is used only by that thread. Elements and handles
+* returned by the priority queue stay valid only until another thread removes them.
+*
+* A priority queue created with the persistent option of pqCreateEx keeps versions of itself: every change
+* makes a new version, which shares all but O(log n) of its memory with the previous one. pqSnapshot pins
+* the current version in O(1), and the snapshot can be read, even by another thread, while the priority
+* queue keeps changing. Elements and priorities removed from the priority queue are freed only when the
+* snapshots which may see them are released.
+* Node pools are not locked, so a concurrent priority queue should not share its node pool with
+* priority queues other than its own copies.
+*
 * The following functions are available:
 *   pqCreate		    - Creates a new empty priority queue
+*   pqCreateWithHash    - Creates a new empty priority queue which keeps a hash index of its elements
 *   pqDestroy		    - Deletes an existing priority queue and frees all resources
+*   pqCreateWithInlineKeys - Creates a new empty priority queue which stores its priorities inside its nodes
+*   pqCreateEx          - Creates a new empty priority queue with the options given in a PQOptions
+*   pqCreateFromArray   - Creates a new priority queue holding the elements of an array
 *   pqCopy		        - Copies an existing priority queue
 *   pqGetSize		    - Returns the size of a given priority queue
 *   pqContains	        - returns whether or not an element exists inside the priority queue.
 *   pqInsert	        - Insert an element with a given priority to the queue.
 *   				        Duplication in the priority queue is allowed.
 *   				        Iterator value is undefined after this operation.
+*   pqInsertOwned       - Insert an element with a given priority to the queue without copying them.
+*   				        Iterator value is undefined after this operation.
+*   pqInsertBatch       - Insert an array of elements with their priorities to the queue at once.
+*   				        Iterator value is undefined after this operation.
 *   pqChangePriority  	- Changes priority of an element with specific priority
 *					        Iterator value is undefined after this operation.
+*   pqChangePriorityOwned - Changes priority of an element with specific priority, without copying the new priority
+*					        Iterator value is undefined after this operation.
 *   pqRemove		    - Removes the highest priority element in the queue
 *                           Iterator value is undefined after this operation.
+*   pqExtract		    - Removes the highest priority element in the queue and returns it without freeing it
+*                           Iterator value is undefined after this operation.
+*   pqRemoveElement     - Removes the highest priority element which is equal to a given element
+*                           Iterator value is undefined after this operation.
+*   pqPopWhile          - Removes the highest priority elements while they satisfy a given predicate
+*                           Iterator value is undefined after this operation.
+*   pqInsertWithHandle  - Insert an element like pqInsert, and return a handle to the inserted element.
+*   pqGetHandle         - Returns a handle to the highest priority element which is equal to a given element
+*   pqGetHandleByHash   - Returns a handle to the highest priority element with a given hash value which a function accepts
+*   pqFindByHash        - Returns the highest priority element with a given hash value which a function accepts
+*   pqGetElementByHandle  - Returns the element of a handle
+*   pqGetPriorityByHandle - Returns the priority of a handle
+*   pqChangePriorityByHandle - Changes the priority of the element of a handle
+*                           Iterator value is undefined after this operation.
+*   pqRemoveByHandle    - Removes the element of a handle
+*                           Iterator value is undefined after this operation.
+*   pqCompact           - Deallocates the nodes left behind by lazy removal
+*                           Iterator value is undefined after this operation.
 *   pqGetFirst	        - Sets the internal iterator to the first element in the priority queue and returns it
 *   pqGetNext		    - Advances the internal iterator to the next key and returns it.
+*   pqPeekK             - Returns the first k elements in the priority queue, without changing it
+*   pqForEachInRange    - Calls a function for every element whose priority is in a given range
+*   pqIterBegin         - Creates an external iterator over the priority queue, independent of the internal one
+*   pqIterNext          - Advances an external iterator and returns the next element
+*   pqIterEnd           - Deallocates an external iterator
+*   pqSnapshot          - Pins the current version of a persistent priority queue
+*   pqRelease           - Releases a snapshot
+*   pqSnapshotGetSize   - Returns the number of elements in a snapshot
+*   pqSnapshotForEach   - Calls a function for every element of a snapshot, in order
+*   pqMerge             - Moves all the elements of a priority queue into another priority queue
 *	pqClear		        - Clears the contents of the priority queue. Frees all the elements of
 *	 				        the queue using the free function.
+*   pqNodePoolCreate    - Creates a new node pool, which can be shared by several priority queues
+*   pqNodePoolDestroy   - Releases a node pool
+*   pqNodePoolGetCapacity - Returns the number of nodes allocated by a node pool
+*   pqNodePoolGetHighWaterMark - Returns the largest number of nodes used at once from a node pool
+*   pqGetMemoryStats    - Reports the memory held by a priority queue, and the most it held at once
+*   pqGetOpStats        - Returns the operation counters of a priority queue, if they are compiled in
+*   pqGetNodePool       - Returns the node pool of a priority queue
+*   pqSetNodePool       - Makes an empty priority queue take its nodes from a given node pool
+*   pqSetBackend        - Makes an empty priority queue use a given backend
+*   pqSetCopyOnWrite    - Makes copies of a priority queue share its nodes until one of them is changed
+*   pqCompareFirst      - Compares the priorities of the highest priority elements of two priority queues
 * 	PQ_FOREACH	        - A macro for iterating over the priority queue's elements.
 */
 
 /** Type for defining the priority queue */
 typedef struct PriorityQueue_t *PriorityQueue;
 
+/**
+* Type for defining a handle to an element inside the priority queue.
+* A handle stays valid until its element is removed from the priority queue,
+* or the priority queue is cleared or destroyed.
+*/
+typedef struct PQNode_t *PQHandle;
+
+/**
+* Type for defining a pool of priority queue nodes.
+* Nodes are allocated in slabs and reused after they are freed. Every priority queue
+* has its own pool, unless it was given a pool shared with other priority queues.
+*/
+typedef struct PQNodePool_t *PQNodePool;
+
+/**
+* Type for defining an external iterator over a priority queue.
+* Every iterator has its own position, so several iterators can traverse a priority queue at once,
+* even from different threads while the priority queue is not changed. An iterator does not change
+* the priority queue or its internal iterator, and it becomes invalid when the priority queue is changed.
+*/
+typedef struct PQIterator_t *PQIterator;
+
+/**
+* Type for defining a snapshot - a version of a persistent priority queue which does not change.
+* A snapshot must be released before its priority queue is destroyed.
+*/
+typedef struct PQSnapshot_t *PQSnapshot;
+
 /** Type used for returning error codes from priority queue functions */
 typedef enum PriorityQueueResult_t {
     PQ_SUCCESS,
@@ -82,6 +176,186 @@ typedef bool(*EqualPQElements)(PQElement, PQElement);
 typedef int(*ComparePQElementPriorities)(PQElementPriority, PQElementPriority);
 
 
+/**
+* Type of function used by the priority queue to hash elements.
+* Elements which are equal by EqualPQElements must have the same hash value.
+*/
+typedef unsigned long(*HashPQElement)(PQElement);
+
+
+/** Type of function used by the priority queue to measure the memory held by an element, in bytes. */
+typedef size_t(*SizePQElement)(PQElement);
+
+/** Type of function used by the priority queue to measure the memory held by a priority, in bytes. */
+typedef size_t(*SizePQElementPriority)(PQElementPriority);
+
+
+/**
+* Type of function used by pqGetHandleByHash and pqFindByHash to pick the element looked for
+* among the elements with its hash value.
+* This function gets an element and the context given to them, and should return:
+* 		true if it is the element looked for;
+*		false otherwise;
+*/
+typedef bool(*MatchPQElement)(PQElement, void*);
+
+
+/**
+* Type of function used by pqPopWhile to decide if the highest priority element should be removed.
+* This function gets the element, its priority and the context given to pqPopWhile, and should return:
+* 		true if the element should be removed;
+*		false otherwise;
+*/
+typedef bool(*PQPredicate)(PQElement, PQElementPriority, void*);
+
+
+/**
+* Type of function used by pqPopWhile to hand every removed element, with its priority and the context
+* given to pqPopWhile, to the caller before they are freed.
+*/
+typedef void(*PQElementCallback)(PQElement, PQElementPriority, void*);
+
+
+/**
+* Type used for defining how a priority queue stores its priorities.
+* PQ_KEY_POINTER - Priorities are allocated using the copy function, and compared using the compare function.
+* PQ_KEY_INT64 - Priorities are int64_t keys stored inside the priority queue, greater keys are higher.
+* PQ_KEY_BYTES - Priorities are keys of a fixed number of bytes stored inside the priority queue,
+*       compared as unsigned bytes like memcmp, greater keys are higher.
+*/
+typedef enum PQKeyType_t {
+    PQ_KEY_POINTER,
+    PQ_KEY_INT64,
+    PQ_KEY_BYTES
+} PQKeyType;
+
+
+/**
+* Type used for choosing the backend of a priority queue, which keeps its elements in order.
+* PQ_BACKEND_BINARY_HEAP - A binary heap. Insert and remove take O(log n). The default.
+* PQ_BACKEND_CALENDAR - A calendar queue, which spreads the elements in buckets by their keys, like days
+*       of a calendar. Insert and remove take O(1) on average, when the elements are removed in
+*       about the order of their keys, and new keys are not much lower than the keys removed so far.
+*       Available only for priority queues with PQ_KEY_INT64 keys.
+* PQ_BACKEND_DARY_HEAP - A heap in which every node has several children, 4 unless set otherwise.
+*       Insert and remove take O(log n), with a shallower heap and fewer cache misses than the binary heap.
+* PQ_BACKEND_PAIRING_HEAP - A pairing heap. Insert takes O(1) and remove takes O(log n) amortized,
+*       which suits priority queues which get many more elements than they give.
+* PQ_BACKEND_SORTED_ARRAY - A sorted array. Insert and remove take O(n), but iterating over the elements
+*       needs no sorting, which suits small priority queues which are iterated often. With PQ_KEY_INT64 keys,
+*       the keys are also kept in a separate contiguous array, which inserts and pqForEachInRange search
+*       with vector compares (AVX2 or SSE4.2, when the CPU supports them) instead of reading the elements.
+* PQ_BACKEND_SKIP_LIST - A skip list, which keeps the elements linked in order. Insert and remove take
+*       O(log n) on average, and pqForEachInRange finds the start of a range in O(log n) without sorting.
+*/
+typedef enum PQBackendType_t {
+    PQ_BACKEND_BINARY_HEAP,
+    PQ_BACKEND_CALENDAR,
+    PQ_BACKEND_DARY_HEAP,
+    PQ_BACKEND_PAIRING_HEAP,
+    PQ_BACKEND_SORTED_ARRAY,
+    PQ_BACKEND_SKIP_LIST
+} PQBackendType;
+
+
+/**
+* Type used for passing the options of a new priority queue to pqCreateEx.
+* Fields which are left zero or NULL get their default value.
+* copy_element, free_element, equal_elements - As in pqCreate. Required.
+* copy_priority, free_priority, compare_priorities - As in pqCreate. Required for PQ_KEY_POINTER keys,
+*       and ignored for inline keys.
+* hash_element - As in pqCreateWithHash, or NULL to keep no index.
+* key_type, key_size, lowest_first - As in pqCreateWithInlineKeys. The default is PQ_KEY_POINTER.
+* backend - See PQBackendType. The default is PQ_BACKEND_BINARY_HEAP.
+* arity - The number of children of a node in PQ_BACKEND_DARY_HEAP, at least 2. The default is 4.
+* copy_on_write - As in pqSetCopyOnWrite.
+* pool - As in pqSetNodePool, or NULL for a pool of the priority queue's own.
+* concurrent - If true, the priority queue can be used by several threads at once, see above.
+* persistent - If true, the priority queue keeps versions of itself for pqSnapshot, see above. Every change
+*       takes O(log n) more time and memory. Cannot be used with copy_on_write.
+* size_element, size_priority - Functions measuring the memory held by every element and priority, which
+*       pqGetMemoryStats adds up, or NULL to leave them out. size_priority is ignored for inline keys.
+* lazy_removal - If true, pqRemoveElement and pqRemoveByHandle free the element at once, but leave its node
+*       in the priority queue as a dead node, which the other functions skip, instead of rearranging the
+*       backend. Removing takes O(1) unless the element is the first one. Cannot be used with persistent.
+* tombstone_ratio - With lazy_removal, the priority queue is compacted when more than this part of its nodes
+*       are dead, which keeps the cost of compacting O(1) amortized per removal. The default is 0.25.
+*/
+typedef struct PQOptions_t {
+    CopyPQElement copy_element;
+    FreePQElement free_element;
+    EqualPQElements equal_elements;
+    CopyPQElementPriority copy_priority;
+    FreePQElementPriority free_priority;
+    ComparePQElementPriorities compare_priorities;
+    HashPQElement hash_element;
+    PQKeyType key_type;
+    int key_size;
+    bool lowest_first;
+    PQBackendType backend;
+    int arity;
+    bool copy_on_write;
+    PQNodePool pool;
+    bool concurrent;
+    bool persistent;
+    SizePQElement size_element;
+    SizePQElementPriority size_priority;
+    bool lazy_removal;
+    double tombstone_ratio;
+} PQOptions;
+
+
+/**
+* Type used by pqGetMemoryStats to report the memory held by a priority queue, in bytes.
+* node_bytes - The nodes of the elements, with their links and inline keys, and the nodes which a
+*       persistent priority queue keeps for its snapshots.
+* element_bytes, priority_bytes - The sums of size_element and size_priority over those nodes, or 0 without them.
+* structure_bytes - The priority queue itself, its arrays, its index, and the structures of its backend
+*       and of its versions. Structures shared by copy-on-write copies are counted by every copy.
+* slack_bytes - Nodes which the node pool allocated and does not use. A shared pool is counted by every
+*       priority queue using it.
+* total_bytes - The sum of all the above.
+* peak_bytes - The most that node_bytes, element_bytes and priority_bytes held together at once.
+*/
+typedef struct PQMemoryStats_t {
+    size_t node_bytes;
+    size_t element_bytes;
+    size_t priority_bytes;
+    size_t structure_bytes;
+    size_t slack_bytes;
+    size_t total_bytes;
+    size_t peak_bytes;
+} PQMemoryStats;
+
+
+/**
+* Type used by pqGetOpStats to report the operations of a priority queue since it was created or copied.
+* The counters are kept only if the library is compiled with PQ_STATS defined (make DEBUG=-DPQ_STATS),
+* and otherwise cost nothing.
+* compare_calls, equal_calls - The calls to compare_priorities and equal_elements.
+* element_copies, priority_copies - The calls to copy_element and copy_priority.
+* node_allocations - The nodes taken from the node pool.
+* key_comparisons - The comparisons of priorities, including inline keys which are compared without
+*       compare_priorities.
+* inserts, insert_scanned - The inserts, and the key comparisons made to put their elements in place.
+*       insert_scanned / inserts is the average scan length of an insert.
+* removes, remove_scanned - The calls to pqRemoveElement, and the elements they compared with equal_elements
+*       to find their element. remove_scanned / removes is the average scan length of a removal.
+*/
+typedef struct PQOpStats_t {
+    unsigned long compare_calls;
+    unsigned long equal_calls;
+    unsigned long element_copies;
+    unsigned long priority_copies;
+    unsigned long node_allocations;
+    unsigned long key_comparisons;
+    unsigned long inserts;
+    unsigned long insert_scanned;
+    unsigned long removes;
+    unsigned long remove_scanned;
+} PQOpStats;
+
+
 /**
 * pqCreate: Allocates a new empty priority queue.
 *
@@ -108,6 +382,91 @@ PriorityQueue pqCreate(CopyPQElement copy_element,
                        FreePQElementPriority free_priority,
                        ComparePQElementPriorities compare_priorities);
 
+/**
+* pqCreateWithHash: Allocates a new empty priority queue, like pqCreate, which also keeps an index of
+* its elements by their hash value. With the index, pqContains, pqRemoveElement, pqChangePriority and
+* pqGetHandle find their element in expected O(1) instead of scanning the whole priority queue, and
+* pqGetHandleByHash and pqFindByHash look elements up by their hash value alone.
+*
+* @param hash_element - Function pointer to be used for hashing elements.
+* 		The other parameters are the same as in pqCreate.
+* @return
+* 	NULL - if one of the parameters is NULL or allocations failed.
+* 	A new priority queue in case of success.
+*/
+PriorityQueue pqCreateWithHash(CopyPQElement copy_element,
+                               FreePQElement free_element,
+                               EqualPQElements equal_elements,
+                               CopyPQElementPriority copy_priority,
+                               FreePQElementPriority free_priority,
+                               ComparePQElementPriorities compare_priorities,
+                               HashPQElement hash_element);
+
+/**
+* pqCreateWithInlineKeys: Allocates a new empty priority queue, which stores its priorities as fixed size
+* keys inside its nodes instead of allocating them, and compares them without calling a function.
+* Priorities are passed to and returned from the priority queue as pointers to keys, which are copied
+* into the priority queue. The priority queue never takes ownership of a key, even in pqInsertOwned and
+* pqChangePriorityOwned. A priority returned by pqExtract is allocated using malloc and freed by the caller.
+*
+* @param key_type - PQ_KEY_INT64 or PQ_KEY_BYTES, see PQKeyType.
+* @param key_size - The number of bytes in a key of PQ_KEY_BYTES. Ignored for PQ_KEY_INT64.
+* @param lowest_first - If true, lower keys have higher priority.
+* @param hash_element - Function pointer to be used for hashing elements, as in pqCreateWithHash,
+* 		or NULL to keep no index.
+* 		The other parameters are the same as in pqCreate.
+* @return
+* 	NULL - if one of the parameters is NULL or invalid, or allocations failed.
+* 	A new priority queue in case of success.
+*/
+PriorityQueue pqCreateWithInlineKeys(CopyPQElement copy_element,
+                                     FreePQElement free_element,
+                                     EqualPQElements equal_elements,
+                                     PQKeyType key_type,
+                                     int key_size,
+                                     bool lowest_first,
+                                     HashPQElement hash_element);
+
+/**
+* pqCreateEx: Allocates a new empty priority queue with the options given in a PQOptions, so every
+* priority queue can get the backend and the key type which suit the way it is used.
+* All the other functions work the same with every choice of options.
+*
+* @param options - The options of the new priority queue, see PQOptions.
+* @return
+* 	NULL - if options is NULL, a required function is NULL, an option is invalid, the backend is not
+* 	available for the keys, or allocations failed.
+* 	A new priority queue in case of success.
+*/
+PriorityQueue pqCreateEx(const PQOptions* options);
+
+/**
+* pqCreateFromArray: Allocates a new priority queue holding the elements of an array with the
+* priorities of a matching array. The priority queue is built in O(n), instead of inserting the
+* elements one by one. Elements with equal priorities are ordered as they appear in the array.
+*
+* @param elements - The elements to put in the priority queue.
+* @param priorities - The priorities of the elements, priorities[i] is the priority of elements[i].
+* @param size - The number of elements in the arrays.
+* @param owned - If true, the priority queue takes ownership of the elements and the priorities
+*       in case of success. Otherwise they are copied using the copy functions.
+* 		The other parameters are the same as in pqCreate.
+* @return
+* 	NULL - if one of the parameters is NULL (including the array entries) or allocations failed.
+* 	In that case owned elements and priorities stay owned by the caller.
+* 	A new priority queue in case of success.
+*/
+PriorityQueue pqCreateFromArray(CopyPQElement copy_element,
+                                FreePQElement free_element,
+                                EqualPQElements equal_elements,
+                                CopyPQElementPriority copy_priority,
+                                FreePQElementPriority free_priority,
+                                ComparePQElementPriorities compare_priorities,
+                                PQElement* elements,
+                                PQElementPriority* priorities,
+                                int size,
+                                bool owned);
+
 /**
 * pqDestroy: Deallocates an existing priority queue. Clears all elements by using the
 * free functions.
@@ -118,7 +477,9 @@ PriorityQueue pqCreate(CopyPQElement copy_element,
 void pqDestroy(PriorityQueue queue);
 
 /**
-* pqCopy: Creates a copy of target priority queue.
+* pqCopy: Creates a copy of target priority queue in O(n).
+* If copy-on-write is set for the priority queue, the copy is created in O(1) and shares the
+* elements of queue, see pqSetCopyOnWrite.
 * Iterator values for both priority queues are undefined after this operation.
 *
 * @param queue - Target priority queue.
@@ -168,6 +529,46 @@ bool pqContains(PriorityQueue queue, PQElement element);
 */
 PriorityQueueResult pqInsert(PriorityQueue queue, PQElement element, PQElementPriority priority);
 
+/**
+*   pqInsertOwned: add a specified element with a specific priority, like pqInsert, without copying them.
+*   The priority queue takes ownership of element and priority, and frees them using the free functions.
+*   Iterator's value is undefined after this operation.
+*
+* @param queue - The priority queue for which to add the data element
+* @param element - The element which need to be added.
+* @param priority - The new priority to associate with the given element.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_OUT_OF_MEMORY if an allocation failed. The element and priority stay owned by the caller.
+* 	PQ_SUCCESS the paired elements had been inserted successfully
+*/
+PriorityQueueResult pqInsertOwned(PriorityQueue queue, PQElement element, PQElementPriority priority);
+
+/**
+*   pqInsertBatch: add an array of elements with their priorities, like calling pqInsert for each of them,
+*   in the order of the array. Instead of placing every element on its own, the new elements are placed
+*   together: the sorted array sorts them and merges them with its elements in O(n + m log m) for m new
+*   elements, and the heaps are rebuilt in O(n + m) when that is cheaper than m inserts.
+*   Persistent priority queues insert the elements one by one.
+*   Iterator's value is undefined after this operation.
+*
+* @param queue - The priority queue for which to add the elements
+* @param elements - The elements which need to be added. A copy of every element is inserted.
+* @param priorities - The priorities of the elements, in the same order.
+* @param size - The number of elements in the arrays.
+* @param results - An array of size results, which is filled with the result of inserting every element,
+*      as pqInsert would return it, or NULL.
+* @return
+* 	PQ_NULL_ARGUMENT if queue is NULL, or the arrays are NULL or size is negative. No element is inserted,
+* 	and results is not filled.
+* 	Otherwise the first result which is not PQ_SUCCESS: PQ_NULL_ARGUMENT for an element or priority which
+* 	is NULL, and PQ_OUT_OF_MEMORY for an element which could not be copied or had no room. The elements
+* 	with other results are inserted.
+* 	PQ_SUCCESS all the elements had been inserted successfully
+*/
+PriorityQueueResult pqInsertBatch(PriorityQueue queue, PQElement* elements, PQElementPriority* priorities,
+                                  int size, PriorityQueueResult* results);
+
 /**
 *	pqChangePriority: Changes a priority of specific element with a specific priority in the priority queue.
 *           If there are multiple same elements with same priority,
@@ -189,6 +590,25 @@ PriorityQueueResult pqInsert(PriorityQueue queue, PQElement element, PQElementPr
 PriorityQueueResult pqChangePriority(PriorityQueue queue, PQElement element,
                                      PQElementPriority old_priority, PQElementPriority new_priority);
 
+/**
+*	pqChangePriorityOwned: Changes a priority of specific element with a specific priority, like pqChangePriority,
+*           without copying the new priority. The priority queue takes ownership of new_priority on success.
+*			Iterator's value is undefined after this operation
+*
+* @param queue - The priority queue for which the element from.
+* @param element - The element which need to be found and whos priority we want to change.
+* @param old_priority - The old priority of the element which need to be changed.
+* @param new_priority - The new priority of the element.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_ELEMENT_DOES_NOT_EXISTS if element with old_priority does not exists in the queue.
+* 	PQ_OUT_OF_MEMORY if an allocation failed.
+* 	PQ_SUCCESS the priority had been changed successfully
+* 	On failure new_priority stays owned by the caller.
+*/
+PriorityQueueResult pqChangePriorityOwned(PriorityQueue queue, PQElement element,
+                                          PQElementPriority old_priority, PQElementPriority new_priority);
+
 /**
 *   pqRemove: Removes the highest priority element from the priority queue.
 *   If there are multiple elements with the same highest priority, the first inserted element should be removed first.
@@ -198,14 +618,35 @@ PriorityQueueResult pqChangePriority(PriorityQueue queue, PQElement element,
 * @param queue - The priority queue to remove the element from.
 * @return
 * 	PQ_NULL_ARGUMENT if a NULL was sent to the function.
+* 	PQ_OUT_OF_MEMORY if the priority queue shared its elements and copying them failed.
 * 	PQ_SUCCESS the most prioritized element had been removed successfully.
 */
 PriorityQueueResult pqRemove(PriorityQueue queue);
 
+/**
+*   pqExtract: Removes the highest priority element from the priority queue, like pqRemove, and hands
+*   the element and its priority to the caller instead of freeing them.
+*   Iterator's value is undefined after this operation.
+*
+* @param queue - The priority queue to remove the element from.
+* @param element - Pointer to assign the removed element into. The caller is responsible for freeing it.
+* @param priority - Pointer to assign the priority of the removed element into.
+*       The caller is responsible for freeing it. If NULL, the priority is freed using the free function.
+*       If the priority queue has snapshots, which may still see the element and its priority, the caller
+*       gets copies of them, made by the copy functions.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as queue or element.
+* 	PQ_ELEMENT_DOES_NOT_EXISTS if the priority queue is empty.
+* 	PQ_OUT_OF_MEMORY if an allocation failed.
+* 	PQ_SUCCESS the most prioritized element had been removed successfully.
+*/
+PriorityQueueResult pqExtract(PriorityQueue queue, PQElement* element, PQElementPriority* priority);
+
 /**
 *   pqRemoveElement: Removes the highest priority element from the priority queue which have its value equal to element.
 *   If there are multiple elements with the same highest priority, the first inserted element should be removed first.
 *   the elements are removed and deallocated using the free functions supplied at initialization.
+*   With lazy removal, the priority is deallocated when the priority queue is compacted, see pqCompact.
 *   Iterator's value is undefined after this operation.
 *
 * @param queue - The priority queue to remove the elements from.
@@ -216,10 +657,29 @@ PriorityQueueResult pqRemove(PriorityQueue queue);
 * @return
 * 	PQ_NULL_ARGUMENT if a NULL was sent to the function.
 * 	PQ_ELEMENT_DOES_NOT_EXISTS if given element does not exists.
+* 	PQ_OUT_OF_MEMORY if the priority queue shared its elements and copying them failed.
 * 	PQ_SUCCESS the most prioritized element had been removed successfully.
 */
 PriorityQueueResult pqRemoveElement(PriorityQueue queue, PQElement element);
 
+/**
+*   pqPopWhile: Removes the highest priority elements from the priority queue, one after the other, while
+*   predicate returns true for them. Stops at the first element for which predicate returns false, so removing
+*   k elements takes O(k log n) with the heap backends, without searching for them.
+*   Iterator's value is undefined after this operation.
+*
+* @param queue - The priority queue to remove the elements from.
+* @param predicate - Function pointer which decides if the highest priority element should be removed.
+* @param context - Passed to predicate and callback as is. May be NULL.
+* @param callback - Function pointer which gets every removed element before it is freed, or NULL.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as queue or predicate.
+* 	PQ_OUT_OF_MEMORY if the priority queue shared its elements and copying them failed.
+* 	PQ_SUCCESS the elements were removed, including when no element satisfied predicate.
+*/
+PriorityQueueResult pqPopWhile(PriorityQueue queue, PQPredicate predicate, void* context,
+                               PQElementCallback callback);
+
 /**
 *	pqGetFirst: Sets the internal iterator (also called current element) to
 *	the first element in the priority queue. The internal order derived from the priorities, and the tie-breaker between
@@ -240,11 +700,258 @@ PQElement pqGetFirst(PriorityQueue queue);
 * @param queue - The priority queue for which to advance the iterator
 * @return
 * 	NULL if reached the end of the priority queue, or the iterator is at an invalid state
+* 	(for example, the priority queue was changed since pqGetFirst was called)
 * 	or a NULL sent as argument
 * 	The next element on the priority queue in case of success
 */
 PQElement pqGetNext(PriorityQueue queue);
 
+/**
+*	pqPeekK: Fills arrays with the first k elements of the priority queue and their priorities, in the same
+*	order as pqGetFirst and pqGetNext, without changing the priority queue or its iterator.
+*	Takes O(k log k) with the heap backends, O(k) with the sorted array backend or if the priority queue was
+*	iterated since it was last changed, and O(n + k log n) otherwise.
+*	The elements and priorities stay in the priority queue, and are valid until it is changed.
+*
+* @param queue - The priority queue to peek into.
+* @param k - The number of elements to return.
+* @param out_elements - An array of at least k elements to fill.
+* @param out_priorities - An array of at least k priorities to fill, or NULL.
+* @return
+* 	-1 if a NULL was sent as queue or out_elements, k is negative, or an allocation failed.
+* 	Otherwise the number of elements filled, which is k or the size of the priority queue if it is smaller.
+*/
+int pqPeekK(PriorityQueue queue, int k, PQElement* out_elements, PQElementPriority* out_priorities);
+
+/**
+*	pqForEachInRange: Calls fn for every element of the priority queue whose priority is between lo and hi,
+*	including both, in the same order as pqGetFirst and pqGetNext, without changing the priority queue or its
+*	iterator. lo and hi may be given in either order.
+*	With the skip list backend, takes O(log n + m) for m elements in the range. With the other backends, takes
+*	O(log n + m) if the priority queue was iterated since it was last changed, and O(n log n) otherwise.
+*	fn must not change the priority queue.
+*
+* @param queue - The priority queue to search in.
+* @param lo - One end of the range of priorities.
+* @param hi - The other end of the range of priorities.
+* @param fn - Function pointer which gets every element in the range, with its priority and ctx.
+* @param ctx - Passed to fn as is. May be NULL.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as queue, lo, hi or fn.
+* 	PQ_OUT_OF_MEMORY if an allocation failed.
+* 	PQ_SUCCESS fn was called for all the elements in the range, including when there were none.
+*/
+PriorityQueueResult pqForEachInRange(PriorityQueue queue, PQElementPriority lo, PQElementPriority hi,
+                                     PQElementCallback fn, void* ctx);
+
+/**
+*	pqIterBegin: Creates an external iterator positioned before the first element of the priority queue,
+*	in the same order as pqGetFirst and pqGetNext. Takes O(n) if the priority queue was iterated since it
+*	was last changed, and O(n log n) otherwise. The iterator must be ended before the priority queue is destroyed.
+*
+* @param queue - The priority queue to iterate over.
+* @return
+* 	NULL if a NULL pointer was sent or an allocation failed.
+* 	A new iterator otherwise.
+*/
+PQIterator pqIterBegin(PriorityQueue queue);
+
+/**
+*	pqIterNext: Advances an external iterator to the next element and returns it, in O(1).
+*
+* @param iterator - The iterator to advance.
+* @return
+* 	NULL if a NULL pointer was sent, the iterator reached the end of the priority queue, or the
+* 	priority queue was changed since pqIterBegin was called.
+* 	The next element on the priority queue in case of success
+*/
+PQElement pqIterNext(PQIterator iterator);
+
+/**
+*	pqIterEnd: Deallocates an external iterator.
+*
+* @param iterator - The iterator to deallocate. If it is NULL nothing will be done
+*/
+void pqIterEnd(PQIterator iterator);
+
+/**
+*	pqSnapshot: Pins the current version of a persistent priority queue in O(1). The snapshot keeps the
+*	elements and priorities the priority queue had, in the same order, while the priority queue changes.
+*	The snapshot must be released by pqRelease before the priority queue is destroyed.
+*
+* @param queue - The persistent priority queue.
+* @return
+* 	NULL if a NULL was sent, the priority queue is not persistent, or an allocation failed.
+* 	A new snapshot otherwise.
+*/
+PQSnapshot pqSnapshot(PriorityQueue queue);
+
+/**
+*	pqRelease: Releases a snapshot. Elements and priorities which were removed from the priority queue
+*	and which no other snapshot may see are freed.
+*
+* @param snapshot - The snapshot to release. If it is NULL nothing will be done
+*/
+void pqRelease(PQSnapshot snapshot);
+
+/**
+*	pqSnapshotGetSize: Returns the number of elements in a snapshot.
+*
+* @param snapshot - The snapshot whose size is requested
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of elements in the snapshot.
+*/
+int pqSnapshotGetSize(PQSnapshot snapshot);
+
+/**
+*	pqSnapshotForEach: Calls fn for every element of a snapshot, with its priority, in the order of the
+*	priority queue when the snapshot was taken, in O(n). The snapshot is read without locking the
+*	priority queue, so other threads may change the priority queue meanwhile.
+*	The elements and priorities must not be changed.
+*
+* @param snapshot - The snapshot to read.
+* @param fn - Function pointer which gets every element of the snapshot, with its priority and ctx.
+* @param ctx - Passed to fn as is. May be NULL.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as snapshot or fn.
+* 	PQ_SUCCESS fn was called for all the elements.
+*/
+PriorityQueueResult pqSnapshotForEach(PQSnapshot snapshot, PQElementCallback fn, void* ctx);
+
+/**
+*   pqInsertWithHandle: add a specified element with a specific priority, like pqInsert,
+*   and return a handle to the inserted element.
+*   Iterator's value is undefined after this operation.
+*
+* @param queue - The priority queue for which to add the data element
+* @param element - The element which need to be added.
+* @param priority - The new priority to associate with the given element.
+* @param handle - Pointer to assign the handle of the inserted element into. May be NULL.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_OUT_OF_MEMORY if an allocation failed
+* 	PQ_SUCCESS the paired elements had been inserted successfully
+*/
+PriorityQueueResult pqInsertWithHandle(PriorityQueue queue, PQElement element, PQElementPriority priority,
+                                       PQHandle* handle);
+
+/**
+*   pqGetHandle: Returns a handle to the highest priority element which is equal to element.
+*   If there are multiple elements with the same highest priority, the handle of the first inserted is returned.
+*
+* @param queue - The priority queue to search in.
+* @param element - The element to look for. Will be compared using the comparison function.
+* @return
+* 	NULL if a NULL was sent, there is no such element or the priority queue shared its
+* 	elements and copying them failed.
+* 	A handle to the element otherwise.
+*/
+PQHandle pqGetHandle(PriorityQueue queue, PQElement element);
+
+/**
+*   pqGetHandleByHash: Returns a handle to the highest priority element with a hash value which match accepts,
+*   looking it up in the hash index of the priority queue, without an element to compare with.
+*   If there are multiple such elements with the same highest priority, the handle of the first inserted is returned.
+*
+* @param queue - The priority queue to search in. Must have been created with a hash function.
+* @param hash - The hash value of the element, as the hash function of the priority queue returns it.
+* @param match - Function called with the elements with that hash value and context, which accepts the element looked for.
+* @param context - Passed to match.
+* @param handle - Pointer to which the handle is assigned.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_ERROR if the priority queue has no hash function.
+* 	PQ_OUT_OF_MEMORY if the priority queue shared its elements and copying them failed.
+* 	PQ_ELEMENT_DOES_NOT_EXISTS if no element with that hash value was accepted.
+* 	PQ_SUCCESS the handle was assigned.
+*/
+PriorityQueueResult pqGetHandleByHash(PriorityQueue queue, unsigned long hash, MatchPQElement match, void* context,
+                                      PQHandle* handle);
+
+/**
+*   pqFindByHash: Returns the highest priority element with a hash value which match accepts, like
+*   pqGetHandleByHash, without changing the priority queue. The element is owned by the priority queue.
+*
+* @param queue - The priority queue to search in. Must have been created with a hash function.
+* @param hash - The hash value of the element, as the hash function of the priority queue returns it.
+* @param match - Function called with the elements with that hash value and context, which accepts the element looked for.
+* @param context - Passed to match.
+* @return
+* 	NULL if a NULL was sent, the priority queue has no hash function or no element with that hash value was accepted.
+* 	The element otherwise.
+*/
+PQElement pqFindByHash(PriorityQueue queue, unsigned long hash, MatchPQElement match, void* context);
+
+/**
+*   pqGetElementByHandle: Returns the element of a handle. The element is owned by the priority queue.
+*
+* @param queue - The priority queue which holds the element.
+* @param handle - The handle of the element.
+* @return
+* 	NULL if a NULL was sent or the handle does not belong to the priority queue.
+* 	The element of the handle otherwise.
+*/
+PQElement pqGetElementByHandle(PriorityQueue queue, PQHandle handle);
+
+/**
+*   pqGetPriorityByHandle: Returns the priority of a handle. The priority is owned by the priority queue.
+*
+* @param queue - The priority queue which holds the element.
+* @param handle - The handle of the element.
+* @return
+* 	NULL if a NULL was sent or the handle does not belong to the priority queue.
+* 	The priority of the handle otherwise.
+*/
+PQElementPriority pqGetPriorityByHandle(PriorityQueue queue, PQHandle handle);
+
+/**
+*	pqChangePriorityByHandle: Changes the priority of the element of a handle in O(log n).
+*           The element is not copied, and it is considered as reinserted element.
+*			Iterator's value is undefined after this operation
+*
+* @param queue - The priority queue which holds the element.
+* @param handle - The handle of the element.
+* @param new_priority - The new priority of the element. A copy of it will be saved.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_OUT_OF_MEMORY if an allocation failed
+* 	PQ_ELEMENT_DOES_NOT_EXISTS if the handle does not belong to the priority queue.
+* 	PQ_SUCCESS the priority had been changed successfully
+*/
+PriorityQueueResult pqChangePriorityByHandle(PriorityQueue queue, PQHandle handle, PQElementPriority new_priority);
+
+/**
+*   pqRemoveByHandle: Removes the element of a handle in O(log n). The element and its priority
+*   are deallocated using the free functions supplied at initialization, and the handle is no longer valid.
+*   With lazy removal, it takes O(1) unless the element is the first one, and the priority is deallocated
+*   when the priority queue is compacted, see pqCompact.
+*   Iterator's value is undefined after this operation.
+*
+* @param queue - The priority queue which holds the element.
+* @param handle - The handle of the element.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_ELEMENT_DOES_NOT_EXISTS if the handle does not belong to the priority queue.
+* 	PQ_OUT_OF_MEMORY if the priority queue is persistent and an allocation failed.
+* 	PQ_SUCCESS the element had been removed successfully
+*/
+PriorityQueueResult pqRemoveByHandle(PriorityQueue queue, PQHandle handle);
+
+/**
+*   pqCompact: Deallocates the dead nodes which lazy removal left in the priority queue, with their
+*   priorities, and rebuilds the backend from the remaining nodes in O(n). The priority queue compacts
+*   itself once its part of dead nodes passes tombstone_ratio, so calling this is only needed to release
+*   their memory sooner, e.g. when the priority queue is idle. Does nothing without lazy removal.
+*   Iterator's value is undefined after this operation.
+*
+* @param queue - The priority queue to compact.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent to the function.
+* 	PQ_SUCCESS the priority queue had been compacted successfully
+*/
+PriorityQueueResult pqCompact(PriorityQueue queue);
+
 /**
 * pqClear: Removes all elements and priorities from target priority queue.
 * The elements are deallocated using the stored free functions.
@@ -252,10 +959,168 @@ PQElement pqGetNext(PriorityQueue queue);
 * 	Target priority queue to remove all element from.
 * @return
 * 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	PQ_OUT_OF_MEMORY - if an allocation failed, the priority queue is not changed.
 * 	MAP_SUCCESS - Otherwise.
 */
 PriorityQueueResult pqClear(PriorityQueue queue);
 
+/**
+* pqMerge: Moves all the elements of source into destination, without copying them. Both priority queues
+* must use the same functions. The elements of source are considered as inserted to destination after
+* its own elements, in the order they were inserted to source. Source stays empty.
+* With the binary and d-ary heap backends, the heap is rebuilt in O(n + m), or the new elements are inserted
+* in O(m log(n + m)) if that is smaller. The sorted array backend sorts the new elements and merges them
+* with its own in O(n + m log m). Other backends insert the new elements one by one.
+* Handles to elements of source stay valid only if both priority queues use the same node pool.
+* Iterator values for both priority queues are undefined after this operation.
+*
+* @param destination - The priority queue to move the elements into.
+* @param source - The priority queue to move the elements from.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_ERROR if the priority queues are the same, use different functions, or source has snapshots
+* 	which were not released.
+* 	PQ_OUT_OF_MEMORY if an allocation failed, both priority queues are not changed.
+* 	PQ_SUCCESS the priority queues had been merged successfully
+*/
+PriorityQueueResult pqMerge(PriorityQueue destination, PriorityQueue source);
+
+/**
+* pqNodePoolCreate: Allocates a new empty node pool.
+*
+* @return
+* 	NULL - if allocation failed.
+* 	A new node pool in case of success.
+*/
+PQNodePool pqNodePoolCreate();
+
+/**
+* pqNodePoolDestroy: Releases a node pool. The pool is deallocated, with all of its slabs,
+* once it is released and no priority queue uses it.
+*
+* @param pool - Target node pool. If pool is NULL nothing will be done.
+*/
+void pqNodePoolDestroy(PQNodePool pool);
+
+/**
+* pqNodePoolGetCapacity: Returns the number of nodes in the slabs allocated by a node pool.
+*
+* @param pool - Target node pool.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of nodes the pool can hand out without allocating.
+*/
+int pqNodePoolGetCapacity(PQNodePool pool);
+
+/**
+* pqNodePoolGetHighWaterMark: Returns the largest number of nodes which were used at once from a node pool.
+*
+* @param pool - Target node pool.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the high-water mark of the pool.
+*/
+int pqNodePoolGetHighWaterMark(PQNodePool pool);
+
+/**
+* pqGetMemoryStats: Reports the memory held by a priority queue, see PQMemoryStats.
+* Elements and priorities are measured by the size_element and size_priority functions given to pqCreateEx.
+*
+* @param queue - The priority queue.
+* @param stats - Pointer to fill with the memory statistics.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters.
+* 	PQ_SUCCESS otherwise.
+*/
+PriorityQueueResult pqGetMemoryStats(PriorityQueue queue, PQMemoryStats* stats);
+
+/**
+* pqGetOpStats: Returns the operation counters of a priority queue, see PQOpStats.
+*
+* @param queue - The priority queue.
+* @param stats - Pointer to fill with the counters.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters.
+* 	PQ_ERROR if the library was compiled without PQ_STATS.
+* 	PQ_SUCCESS otherwise.
+*/
+PriorityQueueResult pqGetOpStats(PriorityQueue queue, PQOpStats* stats);
+
+/**
+* pqGetNodePool: Returns the node pool which a priority queue takes its nodes from.
+* The pool is owned by the priority queue.
+*
+* @param queue - Target priority queue.
+* @return
+* 	NULL if a NULL pointer was sent.
+* 	Otherwise the node pool of the priority queue.
+*/
+PQNodePool pqGetNodePool(PriorityQueue queue);
+
+/**
+* pqSetNodePool: Makes an empty priority queue take its nodes from a given node pool,
+* so several priority queues can share one pool. The caller may release the pool afterwards,
+* it stays allocated while a priority queue uses it.
+* While a pool is shared, pqClear returns the nodes to the pool one by one. A pool used by a single
+* priority queue releases all of its slabs at once when the priority queue is cleared or destroyed.
+*
+* @param queue - Target priority queue.
+* @param pool - The node pool to use.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as one of the parameters
+* 	PQ_ERROR if the priority queue is not empty or has snapshots which were not released, or the pool
+* 	is used by priority queues whose inline keys have a different size.
+* 	PQ_SUCCESS the priority queue uses the node pool.
+*/
+PriorityQueueResult pqSetNodePool(PriorityQueue queue, PQNodePool pool);
+
+/**
+* pqSetBackend: Makes an empty priority queue use a given backend. Copies of the priority queue
+* use the same backend. Only priority queues with the same backend can be merged.
+*
+* @param queue - Target priority queue.
+* @param backend - The backend to use, see PQBackendType.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as queue.
+* 	PQ_ERROR if the priority queue is not empty, or the backend is not available for its keys.
+* 	PQ_OUT_OF_MEMORY if an allocation failed. The priority queue may use the binary heap backend afterwards.
+* 	PQ_SUCCESS the priority queue uses the backend.
+*/
+PriorityQueueResult pqSetBackend(PriorityQueue queue, PQBackendType backend);
+
+/**
+* pqSetCopyOnWrite: Sets whether pqCopy of a priority queue shares its elements instead of copying them.
+* A shared copy is created in O(1). The elements are copied, using the copy functions, only when one
+* of the priority queues sharing them is changed, or when pqGetHandle or pqGetHandleByHash is called on it.
+* While the elements are shared they must not be changed through the pointers returned by the
+* priority queue; call pqGetHandle first and change the element of the handle.
+* Handles taken before a priority queue stops sharing its elements are invalid afterwards.
+* Copies of the priority queue inherit the setting.
+*
+* @param queue - Target priority queue.
+* @param copy_on_write - true to share the elements on pqCopy, false to copy them.
+* @return
+* 	PQ_NULL_ARGUMENT if a NULL was sent as queue.
+* 	PQ_ERROR if copy_on_write is true and the priority queue is persistent.
+* 	PQ_SUCCESS otherwise.
+*/
+PriorityQueueResult pqSetCopyOnWrite(PriorityQueue queue, bool copy_on_write);
+
+/**
+* pqCompareFirst: Compares the priorities of the highest priority elements of two priority queues,
+* which use the same functions. Both priority queues are locked together, so the result is consistent
+* even while other threads change them.
+*
+* @param queue1 - The first priority queue.
+* @param queue2 - The second priority queue.
+* @return
+* 	0 if a NULL was sent as one of the parameters, both priority queues are empty, or the highest
+* 	priorities are equal.
+* 	A positive integer if the highest priority element of queue1 comes first, or only queue2 is empty.
+* 	A negative integer if the highest priority element of queue2 comes first, or only queue1 is empty.
+*/
+int pqCompareFirst(PriorityQueue queue1, PriorityQueue queue2);
+
 /*!
 * Macro for iterating over a priority queue.
 * Declares a new iterator for the loop.
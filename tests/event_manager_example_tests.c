@@ -3,7 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define NUMBER_TESTS 3
+#define NUMBER_TESTS 4
 
 bool testEventManagerCreateDestroy() {
     bool result = true;
@@ -56,16 +56,54 @@ destroyEMTick:
     return result;
 }
 
+bool testEMMembers() {
+    bool result = true;
+
+    Date start_date = dateCreate(1,12,2020);
+    EventManager em = createEventManager(start_date);
+    const char* file_name = "em_members_test.txt";
+    FILE* fd = NULL;
+    char line[32] = "";
+
+    ASSERT_TEST(emAddEventByDiff(em, "event1", 1, 1) == EM_SUCCESS, destroyEMMembers);
+    ASSERT_TEST(emAddMember(em, "member1", 1) == EM_SUCCESS, destroyEMMembers);
+    ASSERT_TEST(emAddMember(em, "member1", 1) == EM_MEMBER_ID_ALREADY_EXISTS, destroyEMMembers);
+    ASSERT_TEST(emAddMemberToEvent(em, 2, 1) == EM_MEMBER_ID_NOT_EXISTS, destroyEMMembers);
+    ASSERT_TEST(emAddMemberToEvent(em, 1, 2) == EM_EVENT_ID_NOT_EXISTS, destroyEMMembers);
+    ASSERT_TEST(emAddMemberToEvent(em, 1, 1) == EM_SUCCESS, destroyEMMembers);
+    ASSERT_TEST(emAddMemberToEvent(em, 1, 1) == EM_EVENT_AND_MEMBER_ALREADY_LINKED, destroyEMMembers);
+    ASSERT_TEST(emRemoveMemberFromEvent(em, 2, 1) == EM_MEMBER_ID_NOT_EXISTS, destroyEMMembers);
+    ASSERT_TEST(emRemoveMemberFromEvent(em, 1, 1) == EM_SUCCESS, destroyEMMembers);
+    ASSERT_TEST(emRemoveMemberFromEvent(em, 1, 1) == EM_EVENT_AND_MEMBER_NOT_LINKED, destroyEMMembers);
+    ASSERT_TEST(emAddMemberToEvent(em, 1, 1) == EM_SUCCESS, destroyEMMembers);
+
+    emPrintAllResponsibleMembers(em, file_name);
+    fd = fopen(file_name, "r");
+    ASSERT_TEST(fd != NULL && fgets(line, sizeof(line), fd) != NULL, destroyEMMembers);
+    ASSERT_TEST(strcmp(line, "member1,1\n") == 0, destroyEMMembers);
+
+destroyEMMembers:
+    if (fd) {
+        fclose(fd);
+    }
+    remove(file_name);
+    dateDestroy(start_date);
+    destroyEventManager(em);
+    return result;
+}
+
 bool (*tests[]) (void) = {
         testEventManagerCreateDestroy,
         testAddEventByDiffAndSize,
-        testEMTick
+        testEMTick,
+        testEMMembers
 };
 
 const char* testNames[] = {
         "testEventManagerCreateDestroy",
         "testAddEventByDiffAndSize",
-        "testEMTick"
+        "testEMTick",
+        "testEMMembers"
 };
 
 int main(int argc, char *argv[]) {
@@ -0,0 +1,115 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../priority_queue.h"
+
+/**
+* Compares the sorted array backend with int64 keys, which searches a contiguous array of its keys with
+* vector compares, with backends which read the nodes to compare their priorities: the sorted array with
+* pointer priorities, and the skip list, which follows the links between the nodes.
+* Usage: key_array_benchmark [elements] [range queries]
+*/
+
+#define DEFAULT_ELEMENTS 20000
+#define DEFAULT_QUERIES 20000
+#define KEY_RANGE 1000000
+#define QUERY_WIDTH 100
+
+static PQElement copyInt(PQElement n) {
+    int *copy = malloc(sizeof(*copy));
+    if (copy) {
+        *copy = *(int *) n;
+    }
+    return copy;
+}
+
+static void freeInt(PQElement n) {
+    free(n);
+}
+
+static bool equalInts(PQElement n1, PQElement n2) {
+    return *(int *) n1 == *(int *) n2;
+}
+
+static PQElementPriority copyKey(PQElementPriority n) {
+    int64_t *copy = malloc(sizeof(*copy));
+    if (copy) {
+        *copy = *(int64_t *) n;
+    }
+    return copy;
+}
+
+static int compareKeys(PQElementPriority n1, PQElementPriority n2) {
+    int64_t key1 = *(int64_t *) n1, key2 = *(int64_t *) n2;
+    return (key1 > key2) - (key1 < key2);
+}
+
+static void countElement(PQElement element, PQElementPriority priority, void* context) {
+    (void) element;
+    (void) priority;
+    (*(long *) context)++;
+}
+
+static unsigned int nextRandom(unsigned int* seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 8;
+}
+
+static double secondsSince(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int runBenchmark(const char* name, PQOptions* options, int elements, int queries) {
+    PriorityQueue queue = pqCreateEx(options);
+    if (!queue) {
+        fprintf(stderr, "Allocation failed\n");
+        return 1;
+    }
+    unsigned int seed = 1;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < elements; i++) {
+        int64_t key = nextRandom(&seed) % KEY_RANGE;
+        pqInsert(queue, &i, &key);
+    }
+    double insert_seconds = secondsSince(&start);
+    long found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < queries; i++) {
+        int64_t low = nextRandom(&seed) % KEY_RANGE, high = low + QUERY_WIDTH;
+        pqForEachInRange(queue, &low, &high, countElement, &found);
+    }
+    double range_seconds = secondsSince(&start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    PQElement element = NULL;
+    while (pqExtract(queue, &element, NULL) == PQ_SUCCESS) {
+        free(element);
+    }
+    double extract_seconds = secondsSince(&start);
+    printf("%-14s insert %8.3fs, range %8.3fs (%ld found), extract %8.3fs\n", name, insert_seconds,
+           range_seconds, found, extract_seconds);
+    pqDestroy(queue);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int elements = argc > 1 ? atoi(argv[1]) : DEFAULT_ELEMENTS;
+    int queries = argc > 2 ? atoi(argv[2]) : DEFAULT_QUERIES;
+    if (elements <= 0 || queries < 0) {
+        fprintf(stderr, "Usage: %s [elements] [range queries]\n", argv[0]);
+        return 1;
+    }
+    PQOptions keys = {copyInt, freeInt, equalInts};
+    keys.key_type = PQ_KEY_INT64;
+    keys.backend = PQ_BACKEND_SORTED_ARRAY;
+    PQOptions pointers = {copyInt, freeInt, equalInts, copyKey, freeInt, compareKeys};
+    pointers.backend = PQ_BACKEND_SORTED_ARRAY;
+    PQOptions skip_list = keys;
+    skip_list.backend = PQ_BACKEND_SKIP_LIST;
+    return runBenchmark("sorted keys", &keys, elements, queries) ||
+           runBenchmark("sorted nodes", &pointers, elements, queries) ||
+           runBenchmark("skip list", &skip_list, elements, queries);
+}
@@ -0,0 +1,186 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "../multi_queue.h"
+
+/**
+* Compares the throughput of a strict concurrent priority queue and a multi queue, and the quality
+* of the order in which the multi queue extracts its elements.
+* Usage: multi_queue_benchmark [threads] [operations per thread]
+*/
+
+#define DEFAULT_THREADS 4
+#define DEFAULT_OPERATIONS 200000
+#define PREFILL_PER_THREAD 10000
+#define QUALITY_ELEMENTS 20000
+#define QUEUES_PER_THREAD 2
+
+static PQElement copyInt(PQElement n) {
+    int *copy = malloc(sizeof(*copy));
+    if (copy) {
+        *copy = *(int *) n;
+    }
+    return copy;
+}
+
+static void freeInt(PQElement n) {
+    free(n);
+}
+
+static bool equalInts(PQElement n1, PQElement n2) {
+    return *(int *) n1 == *(int *) n2;
+}
+
+typedef struct BenchmarkQueue_t {
+    PriorityQueue strict;
+    MultiQueue relaxed;
+} BenchmarkQueue;
+
+typedef struct BenchmarkArgs_t {
+    BenchmarkQueue* queue;
+    int operations;
+    unsigned int seed;
+} BenchmarkArgs;
+
+static PriorityQueueResult benchmarkInsert(BenchmarkQueue* queue, int element, int64_t key) {
+    return queue->strict ? pqInsert(queue->strict, &element, &key) : mqInsert(queue->relaxed, &element, &key);
+}
+
+static PriorityQueueResult benchmarkExtract(BenchmarkQueue* queue, PQElement* element) {
+    return queue->strict ? pqExtract(queue->strict, element, NULL) : mqExtract(queue->relaxed, element, NULL);
+}
+
+static unsigned int nextRandom(unsigned int* seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 8;
+}
+
+static void* runOperations(void* data) {
+    BenchmarkArgs* args = data;
+    for (int i = 0; i < args->operations; i++) {
+        if (i % 2 == 0) {
+            benchmarkInsert(args->queue, i, (int64_t) nextRandom(&args->seed));
+        } else {
+            PQElement element = NULL;
+            if (benchmarkExtract(args->queue, &element) == PQ_SUCCESS) {
+                free(element);
+            }
+        }
+    }
+    return NULL;
+}
+
+static double secondsSince(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double measureThroughput(BenchmarkQueue* queue, int threads, int operations) {
+    unsigned int seed = 1;
+    for (int i = 0; i < threads * PREFILL_PER_THREAD; i++) {
+        benchmarkInsert(queue, i, (int64_t) nextRandom(&seed));
+    }
+    pthread_t* thread_ids = malloc(threads * sizeof(*thread_ids));
+    BenchmarkArgs* args = malloc(threads * sizeof(*args));
+    if (!thread_ids || !args) {
+        free(thread_ids);
+        free(args);
+        return 0;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < threads; t++) {
+        args[t].queue = queue;
+        args[t].operations = operations;
+        args[t].seed = t + 2;
+        pthread_create(&thread_ids[t], NULL, runOperations, &args[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(thread_ids[t], NULL);
+    }
+    double seconds = secondsSince(&start);
+    free(thread_ids);
+    free(args);
+    return (double) threads * operations / seconds;
+}
+
+/** Counts the keys which are still in the queue and higher than key, using a Fenwick tree */
+static int countHigherKeys(const int* tree, int size, int key) {
+    int count = 0;
+    for (int i = size; i > 0; i -= i & -i) {
+        count += tree[i];
+    }
+    for (int i = key + 1; i > 0; i -= i & -i) {
+        count -= tree[i];
+    }
+    return count;
+}
+
+static void removeKey(int* tree, int size, int key) {
+    for (int i = key + 1; i <= size; i += i & -i) {
+        tree[i]--;
+    }
+}
+
+static double measureRankError(BenchmarkQueue* queue) {
+    int* tree = calloc(QUALITY_ELEMENTS + 1, sizeof(*tree));
+    if (!tree) {
+        return -1;
+    }
+    for (int i = 1; i <= QUALITY_ELEMENTS; i++) {
+        tree[i] = i & -i;
+    }
+    for (int i = 0; i < QUALITY_ELEMENTS; i++) {
+        int key = (int) ((unsigned int) i * 7919u % QUALITY_ELEMENTS);
+        benchmarkInsert(queue, key, key);
+    }
+    long total_error = 0;
+    PQElement element = NULL;
+    while (benchmarkExtract(queue, &element) == PQ_SUCCESS) {
+        int key = *(int *) element;
+        total_error += countHigherKeys(tree, QUALITY_ELEMENTS, key);
+        removeKey(tree, QUALITY_ELEMENTS, key);
+        free(element);
+    }
+    free(tree);
+    return (double) total_error / QUALITY_ELEMENTS;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = argc > 1 ? atoi(argv[1]) : DEFAULT_THREADS;
+    int operations = argc > 2 ? atoi(argv[2]) : DEFAULT_OPERATIONS;
+    if (threads <= 0 || operations <= 0) {
+        fprintf(stderr, "Usage: %s [threads] [operations per thread]\n", argv[0]);
+        return 1;
+    }
+    PQOptions options = {copyInt, freeInt, equalInts};
+    options.key_type = PQ_KEY_INT64;
+    options.concurrent = true;
+    for (int relaxed = 0; relaxed < 2; relaxed++) {
+        BenchmarkQueue queue = {NULL, NULL};
+        if (relaxed) {
+            queue.relaxed = mqCreate(&options, threads * QUEUES_PER_THREAD);
+        } else {
+            queue.strict = pqCreateEx(&options);
+        }
+        if (!queue.strict && !queue.relaxed) {
+            fprintf(stderr, "Allocation failed\n");
+            return 1;
+        }
+        double throughput = measureThroughput(&queue, threads, operations);
+        pqClear(queue.strict);
+        PQElement element = NULL;
+        while (queue.relaxed && mqExtract(queue.relaxed, &element, NULL) == PQ_SUCCESS) {
+            free(element);
+        }
+        double rank_error = measureRankError(&queue);
+        printf("%-8s %d threads: %12.0f operations/s, mean rank error %.2f\n", relaxed ? "multi" : "strict",
+               threads, throughput, rank_error);
+        pqDestroy(queue.strict);
+        mqDestroy(queue.relaxed);
+    }
+    return 0;
+}
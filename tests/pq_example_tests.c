@@ -1,8 +1,12 @@
 #include "test_utilities.h"
 #include "../priority_queue.h"
+#include "../typed_priority_queue.h"
 #include <stdlib.h>
+#include <pthread.h>
 
-#define NUMBER_TESTS 4
+#define NUMBER_TESTS 29
+#define NUMBER_THREADS 4
+#define ELEMENTS_PER_THREAD 1000
 
 static PQElementPriority copyIntGeneric(PQElementPriority n) {
     if (!n) {
@@ -28,6 +32,30 @@ static bool equalIntsGeneric(PQElementPriority n1, PQElementPriority n2) {
     return *(int *) n1 == *(int *) n2;
 }
 
+static unsigned long hashIntGeneric(PQElement n) {
+    return (unsigned long)*(int *) n;
+}
+
+static bool isIntGeneric(PQElement n, void *context) {
+    return *(int *) n == *(int *) context;
+}
+
+static bool fail_copies = false;
+
+static PQElement copyIntFailing(PQElement n) {
+    return fail_copies ? NULL : copyIntGeneric(n);
+}
+
+static size_t sizeIntGeneric(PQElement n) {
+    return sizeof(*(int *) n);
+}
+
+static inline int compareIntValues(int n1, int n2) {
+    return n1 - n2;
+}
+
+DEFINE_TYPED_PQ(IntPQ, int, int, compareIntValues)
+
 bool testPQCreateDestroy() {
     bool result = true;
 
@@ -95,18 +123,1024 @@ destroyPQIterator:
     return result;
 }
 
+bool testPQOrder() {
+    bool result = true;
+    PriorityQueue pq = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+
+    int priorities[] = {3, 7, 1, 7, 5, 3, 9, 1};
+    int size = sizeof(priorities) / sizeof(*priorities);
+    for(int i=0; i< size; i++){
+        ASSERT_TEST(pqInsert(pq, &i, &priorities[i]) == PQ_SUCCESS, destroyPQOrder);
+    }
+
+    int expected[] = {6, 1, 3, 4, 0, 5, 2, 7};
+    int i = 0;
+    PQ_FOREACH(int*, iter, pq) {
+        ASSERT_TEST(*iter == expected[i], destroyPQOrder);
+        i++;
+    }
+    ASSERT_TEST(i == size, destroyPQOrder);
+    ASSERT_TEST(pqRemove(pq) == PQ_SUCCESS, destroyPQOrder);
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 1, destroyPQOrder);
+
+destroyPQOrder:
+    pqDestroy(pq);
+    return result;
+}
+
+bool testPQIteratorInvalidation() {
+    bool result = true;
+    PriorityQueue pq = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+
+    for(int i=0; i< 5; i++){
+        ASSERT_TEST(pqInsert(pq, &i, &i) == PQ_SUCCESS, destroyPQIteratorInvalidation);
+    }
+    ASSERT_TEST(pqGetSize(pq) == 5, destroyPQIteratorInvalidation);
+    ASSERT_TEST(pqGetFirst(pq) != NULL, destroyPQIteratorInvalidation);
+    ASSERT_TEST(pqGetNext(pq) != NULL, destroyPQIteratorInvalidation);
+    int to_add = 10;
+    ASSERT_TEST(pqInsert(pq, &to_add, &to_add) == PQ_SUCCESS, destroyPQIteratorInvalidation);
+    ASSERT_TEST(pqGetNext(pq) == NULL, destroyPQIteratorInvalidation);
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == to_add, destroyPQIteratorInvalidation);
+    ASSERT_TEST(pqGetNext(pq) != NULL, destroyPQIteratorInvalidation);
+
+destroyPQIteratorInvalidation:
+    pqDestroy(pq);
+    return result;
+}
+
+bool testPQHandles() {
+    bool result = true;
+    PriorityQueue pq = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+
+    PQHandle handles[5];
+    for(int i=0; i< 5; i++){
+        ASSERT_TEST(pqInsertWithHandle(pq, &i, &i, &handles[i]) == PQ_SUCCESS, destroyPQHandles);
+    }
+    ASSERT_TEST(pqGetHandle(pq, &(int){2}) == handles[2], destroyPQHandles);
+    ASSERT_TEST(*(int*)pqGetElementByHandle(pq, handles[3]) == 3, destroyPQHandles);
+
+    int new_priority = 10;
+    ASSERT_TEST(pqChangePriorityByHandle(pq, handles[1], &new_priority) == PQ_SUCCESS, destroyPQHandles);
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 1, destroyPQHandles);
+    ASSERT_TEST(*(int*)pqGetPriorityByHandle(pq, handles[1]) == new_priority, destroyPQHandles);
+
+    ASSERT_TEST(pqRemoveByHandle(pq, handles[1]) == PQ_SUCCESS, destroyPQHandles);
+    ASSERT_TEST(pqRemoveByHandle(pq, handles[4]) == PQ_SUCCESS, destroyPQHandles);
+    ASSERT_TEST(pqGetSize(pq) == 3, destroyPQHandles);
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 3, destroyPQHandles);
+    ASSERT_TEST(!pqContains(pq, &(int){4}), destroyPQHandles);
+
+destroyPQHandles:
+    pqDestroy(pq);
+    return result;
+}
+
+bool testPQHashIndex() {
+    bool result = true;
+    PriorityQueue pq = pqCreateWithHash(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric,
+                                        compareIntsGeneric, hashIntGeneric);
+    ASSERT_TEST(pq != NULL, returnPQHashIndex);
+
+    int max_value = 100;
+    for(int i=0; i< max_value; i++){
+        int priority = i % 10;
+        ASSERT_TEST(pqInsert(pq, &i, &priority) == PQ_SUCCESS, destroyPQHashIndex);
+    }
+    for(int i=0; i< max_value; i+=2){
+        ASSERT_TEST(pqRemoveElement(pq, &i) == PQ_SUCCESS, destroyPQHashIndex);
+    }
+    ASSERT_TEST(pqGetSize(pq) == max_value / 2, destroyPQHashIndex);
+    for(int i=0; i< max_value; i++){
+        ASSERT_TEST(pqContains(pq, &i) == (i % 2 == 1), destroyPQHashIndex);
+    }
+    int old_priority = 9, new_priority = 10;
+    ASSERT_TEST(pqChangePriority(pq, &(int){39}, &old_priority, &new_priority) == PQ_SUCCESS, destroyPQHashIndex);
+    ASSERT_TEST(pqChangePriority(pq, &(int){40}, &old_priority, &new_priority) == PQ_ELEMENT_DOES_NOT_EXISTS,
+                destroyPQHashIndex);
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 39, destroyPQHashIndex);
+
+    PQHandle handle = NULL;
+    int seven = 7, eight = 8;
+    ASSERT_TEST(pqGetHandleByHash(pq, 7, isIntGeneric, &seven, &handle) == PQ_SUCCESS, destroyPQHashIndex);
+    ASSERT_TEST(*(int*)pqGetElementByHandle(pq, handle) == 7, destroyPQHashIndex);
+    ASSERT_TEST(pqGetHandleByHash(pq, 8, isIntGeneric, &eight, &handle) == PQ_ELEMENT_DOES_NOT_EXISTS,
+                destroyPQHashIndex);
+    ASSERT_TEST(pqGetHandleByHash(pq, 8, isIntGeneric, &seven, &handle) == PQ_ELEMENT_DOES_NOT_EXISTS,
+                destroyPQHashIndex);
+    ASSERT_TEST(pqGetHandleByHash(pq, 7, NULL, &seven, &handle) == PQ_NULL_ARGUMENT, destroyPQHashIndex);
+    ASSERT_TEST(*(int*)pqFindByHash(pq, 7, isIntGeneric, &seven) == 7, destroyPQHashIndex);
+    ASSERT_TEST(pqFindByHash(pq, 8, isIntGeneric, &eight) == NULL, destroyPQHashIndex);
+
+destroyPQHashIndex:
+    pqDestroy(pq);
+returnPQHashIndex:
+    return result;
+}
+
+bool testPQNodePool() {
+    bool result = true;
+    PriorityQueue pq1 = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    PriorityQueue pq2 = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    PQNodePool pool = pqNodePoolCreate();
+    ASSERT_TEST(pool != NULL, destroyPQNodePool);
+    ASSERT_TEST(pqSetNodePool(pq1, pool) == PQ_SUCCESS, destroyPQNodePool);
+    ASSERT_TEST(pqSetNodePool(pq2, pool) == PQ_SUCCESS, destroyPQNodePool);
+
+    for(int i=0; i< 20; i++){
+        ASSERT_TEST(pqInsert(i % 2 ? pq1 : pq2, &i, &i) == PQ_SUCCESS, destroyPQNodePool);
+    }
+    ASSERT_TEST(pqSetNodePool(pq1, pool) == PQ_ERROR, destroyPQNodePool);
+    ASSERT_TEST(pqNodePoolGetHighWaterMark(pool) == 20, destroyPQNodePool);
+    int capacity = pqNodePoolGetCapacity(pool);
+    ASSERT_TEST(capacity >= 20, destroyPQNodePool);
+    ASSERT_TEST(pqClear(pq1) == PQ_SUCCESS, destroyPQNodePool);
+    for(int i=0; i< 10; i++){
+        ASSERT_TEST(pqInsert(pq2, &i, &i) == PQ_SUCCESS, destroyPQNodePool);
+    }
+    ASSERT_TEST(pqNodePoolGetCapacity(pool) == capacity, destroyPQNodePool);
+    ASSERT_TEST(pqNodePoolGetHighWaterMark(pool) == 20, destroyPQNodePool);
+
+destroyPQNodePool:
+    pqNodePoolDestroy(pool);
+    pqDestroy(pq1);
+    pqDestroy(pq2);
+    return result;
+}
+
+bool testPQOwnership() {
+    bool result = true;
+    PriorityQueue pq = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+
+    for(int i=0; i< 5; i++){
+        int* element = copyIntGeneric(&i);
+        int* priority = copyIntGeneric(&i);
+        ASSERT_TEST(pqInsertOwned(pq, element, priority) == PQ_SUCCESS, destroyPQOwnership);
+        ASSERT_TEST(pqGetFirst(pq) == element, destroyPQOwnership);
+    }
+    int old_priority = 0;
+    int* new_priority = copyIntGeneric(&(int){10});
+    ASSERT_TEST(pqChangePriorityOwned(pq, &(int){0}, &old_priority, new_priority) == PQ_SUCCESS, destroyPQOwnership);
+
+    PQElement element = NULL;
+    PQElementPriority priority = NULL;
+    ASSERT_TEST(pqExtract(pq, &element, &priority) == PQ_SUCCESS, destroyPQOwnership);
+    ASSERT_TEST(*(int*)element == 0 && priority == new_priority, destroyPQOwnership);
+    freeIntGeneric(element);
+    freeIntGeneric(priority);
+    ASSERT_TEST(pqGetSize(pq) == 4, destroyPQOwnership);
+    ASSERT_TEST(pqExtract(pq, &element, NULL) == PQ_SUCCESS, destroyPQOwnership);
+    ASSERT_TEST(*(int*)element == 4, destroyPQOwnership);
+    freeIntGeneric(element);
+    ASSERT_TEST(pqClear(pq) == PQ_SUCCESS, destroyPQOwnership);
+    ASSERT_TEST(pqExtract(pq, &element, NULL) == PQ_ELEMENT_DOES_NOT_EXISTS, destroyPQOwnership);
+
+destroyPQOwnership:
+    pqDestroy(pq);
+    return result;
+}
+
+bool testPQCreateFromArray() {
+    bool result = true;
+    int values[] = {0, 1, 2, 3, 4, 5, 6, 7};
+    int priorities[] = {3, 7, 1, 7, 5, 3, 9, 1};
+    PQElement elements_array[8];
+    PQElementPriority priorities_array[8];
+    for(int i=0; i< 8; i++){
+        elements_array[i] = &values[i];
+        priorities_array[i] = &priorities[i];
+    }
+    PriorityQueue pq = pqCreateFromArray(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric,
+                                         freeIntGeneric, compareIntsGeneric, elements_array, priorities_array, 8, false);
+    PriorityQueue copy = pqCopy(pq);
+    ASSERT_TEST(pq != NULL && copy != NULL, destroyPQCreateFromArray);
+    ASSERT_TEST(pqGetSize(pq) == 8, destroyPQCreateFromArray);
+
+    int expected[] = {6, 1, 3, 4, 0, 5, 2, 7};
+    int i = 0;
+    PQ_FOREACH(int*, iter, copy) {
+        ASSERT_TEST(*iter == expected[i], destroyPQCreateFromArray);
+        i++;
+    }
+    ASSERT_TEST(i == 8, destroyPQCreateFromArray);
+
+destroyPQCreateFromArray:
+    pqDestroy(pq);
+    pqDestroy(copy);
+    return result;
+}
+
+bool testPQMerge() {
+    bool result = true;
+    PriorityQueue pq1 = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    PriorityQueue pq2 = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+
+    for(int i=0; i< 10; i++){
+        int priority = i / 2;
+        ASSERT_TEST(pqInsert(i % 2 ? pq1 : pq2, &i, &priority) == PQ_SUCCESS, destroyPQMerge);
+    }
+    ASSERT_TEST(pqMerge(pq1, pq1) == PQ_ERROR, destroyPQMerge);
+    ASSERT_TEST(pqMerge(pq1, pq2) == PQ_SUCCESS, destroyPQMerge);
+    ASSERT_TEST(pqGetSize(pq1) == 10 && pqGetSize(pq2) == 0, destroyPQMerge);
+
+    int expected[] = {9, 8, 7, 6, 5, 4, 3, 2, 1, 0};
+    int i = 0;
+    PQ_FOREACH(int*, iter, pq1) {
+        ASSERT_TEST(*iter == expected[i], destroyPQMerge);
+        i++;
+    }
+
+destroyPQMerge:
+    pqDestroy(pq1);
+    pqDestroy(pq2);
+    return result;
+}
+
+bool testPQCopyOnWrite() {
+    bool result = true;
+    PriorityQueue pq = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    PriorityQueue copy = NULL;
+    PriorityQueue copy2 = NULL;
+    ASSERT_TEST(pqSetCopyOnWrite(pq, true) == PQ_SUCCESS, destroyPQCopyOnWrite);
+    for(int i=0; i< 5; i++){
+        ASSERT_TEST(pqInsert(pq, &i, &i) == PQ_SUCCESS, destroyPQCopyOnWrite);
+    }
+    copy = pqCopy(pq);
+    copy2 = pqCopy(copy);
+    ASSERT_TEST(copy != NULL && copy2 != NULL, destroyPQCopyOnWrite);
+    ASSERT_TEST(pqGetFirst(copy) == pqGetFirst(pq), destroyPQCopyOnWrite);
+
+    int ten = 10;
+    ASSERT_TEST(pqRemove(pq) == PQ_SUCCESS, destroyPQCopyOnWrite);
+    ASSERT_TEST(pqInsert(copy, &ten, &ten) == PQ_SUCCESS, destroyPQCopyOnWrite);
+    ASSERT_TEST(pqGetSize(pq) == 4 && pqGetSize(copy) == 6 && pqGetSize(copy2) == 5, destroyPQCopyOnWrite);
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 3, destroyPQCopyOnWrite);
+    ASSERT_TEST(*(int*)pqGetFirst(copy) == 10, destroyPQCopyOnWrite);
+    ASSERT_TEST(*(int*)pqGetFirst(copy2) == 4, destroyPQCopyOnWrite);
+    ASSERT_TEST(pqClear(copy2) == PQ_SUCCESS && pqGetSize(copy2) == 0, destroyPQCopyOnWrite);
+    ASSERT_TEST(pqGetSize(copy) == 6, destroyPQCopyOnWrite);
+
+    pqDestroy(copy2);
+    copy2 = NULL;
+    ASSERT_TEST(pqGetHandleByHash(pq, 3, isIntGeneric, &(int){3}, &(PQHandle){NULL}) == PQ_ERROR,
+                destroyPQCopyOnWrite);
+    copy2 = pqCreateWithHash(copyIntFailing, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric,
+                             compareIntsGeneric, hashIntGeneric);
+    ASSERT_TEST(copy2 != NULL && pqSetCopyOnWrite(copy2, true) == PQ_SUCCESS, destroyPQCopyOnWrite);
+    ASSERT_TEST(pqInsert(copy2, &ten, &ten) == PQ_SUCCESS, destroyPQCopyOnWrite);
+    pqDestroy(copy);
+    copy = pqCopy(copy2);
+    ASSERT_TEST(copy != NULL, destroyPQCopyOnWrite);
+    PQHandle handle = NULL;
+    fail_copies = true;
+    ASSERT_TEST(pqGetHandleByHash(copy, 10, isIntGeneric, &ten, &handle) == PQ_OUT_OF_MEMORY, destroyPQCopyOnWrite);
+    ASSERT_TEST(pqFindByHash(copy, 10, isIntGeneric, &ten) == pqFindByHash(copy2, 10, isIntGeneric, &ten),
+                destroyPQCopyOnWrite);
+    fail_copies = false;
+    ASSERT_TEST(pqGetHandleByHash(copy, 10, isIntGeneric, &ten, &handle) == PQ_SUCCESS, destroyPQCopyOnWrite);
+    ASSERT_TEST(pqGetElementByHandle(copy, handle) != pqFindByHash(copy2, 10, isIntGeneric, &ten),
+                destroyPQCopyOnWrite);
+
+destroyPQCopyOnWrite:
+    fail_copies = false;
+    pqDestroy(pq);
+    pqDestroy(copy);
+    pqDestroy(copy2);
+    return result;
+}
+
+bool testPQInlineKeys() {
+    bool result = true;
+    PriorityQueue pq = pqCreateWithInlineKeys(copyIntGeneric, freeIntGeneric, equalIntsGeneric, PQ_KEY_INT64, 0, true, NULL);
+    PriorityQueue pq_bytes = pqCreateWithInlineKeys(copyIntGeneric, freeIntGeneric, equalIntsGeneric, PQ_KEY_BYTES, 12, false, NULL);
+    ASSERT_TEST(pq != NULL && pq_bytes != NULL, destroyPQInlineKeys);
+    ASSERT_TEST(pqCreateWithInlineKeys(copyIntGeneric, freeIntGeneric, equalIntsGeneric, PQ_KEY_BYTES, 0, false, NULL) == NULL,
+                destroyPQInlineKeys);
+
+    for(int i=0; i< 5; i++){
+        int64_t key = 100 - i;
+        ASSERT_TEST(pqInsert(pq, &i, &key) == PQ_SUCCESS, destroyPQInlineKeys);
+        char bytes[12] = {1, (char)i};
+        ASSERT_TEST(pqInsert(pq_bytes, &i, bytes) == PQ_SUCCESS, destroyPQInlineKeys);
+    }
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 4 && *(int*)pqGetFirst(pq_bytes) == 4, destroyPQInlineKeys);
+    int64_t old_key = 98, new_key = 50;
+    int two = 2;
+    ASSERT_TEST(pqChangePriority(pq, &two, &old_key, &new_key) == PQ_SUCCESS, destroyPQInlineKeys);
+    ASSERT_TEST(*(int64_t*)pqGetPriorityByHandle(pq, pqGetHandle(pq, &two)) == 50, destroyPQInlineKeys);
+
+    PQElement element = NULL;
+    PQElementPriority priority = NULL;
+    ASSERT_TEST(pqExtract(pq, &element, &priority) == PQ_SUCCESS, destroyPQInlineKeys);
+    ASSERT_TEST(*(int*)element == 2 && *(int64_t*)priority == 50, destroyPQInlineKeys);
+    free(element);
+    free(priority);
+    ASSERT_TEST(pqClear(pq_bytes) == PQ_SUCCESS, destroyPQInlineKeys);
+    ASSERT_TEST(pqSetNodePool(pq_bytes, pqGetNodePool(pq)) == PQ_ERROR, destroyPQInlineKeys);
+
+destroyPQInlineKeys:
+    pqDestroy(pq);
+    pqDestroy(pq_bytes);
+    return result;
+}
+
+bool testPQCalendar() {
+    bool result = true;
+    PriorityQueue pq = pqCreateWithInlineKeys(copyIntGeneric, freeIntGeneric, equalIntsGeneric, PQ_KEY_INT64, 0, true, NULL);
+    PriorityQueue pq_pointers = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    ASSERT_TEST(pqSetBackend(pq_pointers, PQ_BACKEND_CALENDAR) == PQ_ERROR, destroyPQCalendar);
+    ASSERT_TEST(pqSetBackend(pq, PQ_BACKEND_CALENDAR) == PQ_SUCCESS, destroyPQCalendar);
+
+    for(int i=0; i< 100; i++){
+        int64_t day = (i * 37) % 100;
+        ASSERT_TEST(pqInsert(pq, &i, &day) == PQ_SUCCESS, destroyPQCalendar);
+    }
+    ASSERT_TEST(pqSetBackend(pq, PQ_BACKEND_BINARY_HEAP) == PQ_ERROR, destroyPQCalendar);
+    for(int64_t day=0; day< 100; day++){
+        PQElement element = NULL;
+        PQElementPriority priority = NULL;
+        ASSERT_TEST(pqExtract(pq, &element, &priority) == PQ_SUCCESS, destroyPQCalendar);
+        bool in_order = *(int64_t*)priority == day;
+        free(element);
+        free(priority);
+        ASSERT_TEST(in_order, destroyPQCalendar);
+        int later_element = (int)day + 1000;
+        int64_t later = day + 1000;
+        ASSERT_TEST(pqInsert(pq, &later_element, &later) == PQ_SUCCESS, destroyPQCalendar);
+    }
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 1000, destroyPQCalendar);
+
+destroyPQCalendar:
+    pqDestroy(pq);
+    pqDestroy(pq_pointers);
+    return result;
+}
+
+bool testPQBackends() {
+    bool result = true;
+    PQOptions options = {copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric,
+                         compareIntsGeneric};
+    options.backend = PQ_BACKEND_CALENDAR;
+    ASSERT_TEST(pqCreateEx(&options) == NULL, returnPQBackends);
+    options.backend = PQ_BACKEND_DARY_HEAP;
+    options.arity = 1;
+    ASSERT_TEST(pqCreateEx(&options) == NULL, returnPQBackends);
+    options.arity = 3;
+
+    PQBackendType backends[] = {PQ_BACKEND_DARY_HEAP, PQ_BACKEND_PAIRING_HEAP, PQ_BACKEND_SORTED_ARRAY};
+    for(int b=0; b< 3; b++){
+        options.backend = backends[b];
+        PriorityQueue pq = pqCreateEx(&options);
+        ASSERT_TEST(pq != NULL, returnPQBackends);
+        for(int i=0; i< 50; i++){
+            int priority = (i * 17) % 50;
+            ASSERT_TEST(pqInsert(pq, &i, &priority) == PQ_SUCCESS, destroyPQBackends);
+        }
+        int old_priority = (10 * 17) % 50, new_priority = 100;
+        int ten = 10;
+        ASSERT_TEST(pqChangePriority(pq, &ten, &old_priority, &new_priority) == PQ_SUCCESS, destroyPQBackends);
+        ASSERT_TEST(*(int*)pqGetFirst(pq) == 10, destroyPQBackends);
+        ASSERT_TEST(pqRemove(pq) == PQ_SUCCESS, destroyPQBackends);
+        int expected = 49;
+        PQ_FOREACH(int*, element, pq) {
+            if(expected == (10 * 17) % 50){
+                expected--;
+            }
+            ASSERT_TEST((*element * 17) % 50 == expected, destroyPQBackends);
+            expected--;
+        }
+        ASSERT_TEST(expected == -1, destroyPQBackends);
+    destroyPQBackends:
+        pqDestroy(pq);
+        if(!result){
+            break;
+        }
+    }
+
+returnPQBackends:
+    return result;
+}
+
+typedef struct ConcurrentTestArgs_t {
+    PriorityQueue pq;
+    int first;
+    bool in_order;
+} ConcurrentTestArgs;
+
+static void* insertConcurrently(void* data) {
+    ConcurrentTestArgs* args = data;
+    args->in_order = true;
+    for(int i = args->first; i < args->first + ELEMENTS_PER_THREAD; i++){
+        if(pqInsert(args->pq, &i, &i) != PQ_SUCCESS){
+            args->in_order = false;
+        }
+        if(i % 100 == 0){
+            PriorityQueue snapshot = pqCopy(args->pq);
+            int last = NUMBER_THREADS * ELEMENTS_PER_THREAD;
+            PQ_FOREACH(int*, element, snapshot) {
+                args->in_order = args->in_order && *element < last;
+                last = *element;
+            }
+            pqDestroy(snapshot);
+        }
+    }
+    return NULL;
+}
+
+static void* extractConcurrently(void* data) {
+    ConcurrentTestArgs* args = data;
+    args->in_order = true;
+    int last = NUMBER_THREADS * ELEMENTS_PER_THREAD;
+    for(int i = 0; i < ELEMENTS_PER_THREAD; i++){
+        PQElement element = NULL;
+        if(pqExtract(args->pq, &element, NULL) != PQ_SUCCESS){
+            args->in_order = false;
+            continue;
+        }
+        args->in_order = args->in_order && *(int*)element < last;
+        last = *(int*)element;
+        free(element);
+    }
+    return NULL;
+}
+
+bool testPQConcurrent() {
+    bool result = true;
+    PQOptions options = {copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric,
+                         compareIntsGeneric};
+    options.copy_on_write = true;
+    options.concurrent = true;
+    PriorityQueue pq = pqCreateEx(&options);
+    pthread_t threads[NUMBER_THREADS];
+    ConcurrentTestArgs args[NUMBER_THREADS];
+    void* (*phases[]) (void*) = {insertConcurrently, extractConcurrently};
+    ASSERT_TEST(pq != NULL, destroyPQConcurrent);
+
+    for(int phase=0; phase< 2; phase++){
+        for(int t=0; t< NUMBER_THREADS; t++){
+            args[t].pq = pq;
+            args[t].first = t * ELEMENTS_PER_THREAD;
+            pthread_create(&threads[t], NULL, phases[phase], &args[t]);
+        }
+        for(int t=0; t< NUMBER_THREADS; t++){
+            pthread_join(threads[t], NULL);
+        }
+        for(int t=0; t< NUMBER_THREADS; t++){
+            ASSERT_TEST(args[t].in_order, destroyPQConcurrent);
+        }
+        ASSERT_TEST(pqGetSize(pq) == (phase == 0 ? NUMBER_THREADS * ELEMENTS_PER_THREAD : 0), destroyPQConcurrent);
+    }
+
+destroyPQConcurrent:
+    pqDestroy(pq);
+    return result;
+}
+
+bool testPQCompareFirst() {
+    bool result = true;
+    PriorityQueue pq1 = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    PriorityQueue pq2 = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    int low = 1, high = 2;
+    ASSERT_TEST(pqCompareFirst(pq1, pq2) == 0, destroyPQCompareFirst);
+    ASSERT_TEST(pqInsert(pq1, &low, &low) == PQ_SUCCESS, destroyPQCompareFirst);
+    ASSERT_TEST(pqCompareFirst(pq1, pq2) > 0, destroyPQCompareFirst);
+    ASSERT_TEST(pqInsert(pq2, &high, &high) == PQ_SUCCESS, destroyPQCompareFirst);
+    ASSERT_TEST(pqCompareFirst(pq1, pq2) < 0, destroyPQCompareFirst);
+    ASSERT_TEST(pqCompareFirst(pq2, pq1) > 0, destroyPQCompareFirst);
+
+destroyPQCompareFirst:
+    pqDestroy(pq1);
+    pqDestroy(pq2);
+    return result;
+}
+
+bool testPQExternalIterators() {
+    bool result = true;
+    PriorityQueue pq = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    PQIterator outer = NULL, inner = NULL;
+    for(int i=0; i< 10; i++){
+        ASSERT_TEST(pqInsert(pq, &i, &i) == PQ_SUCCESS, destroyPQExternalIterators);
+    }
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 9, destroyPQExternalIterators);
+    outer = pqIterBegin(pq);
+    ASSERT_TEST(outer != NULL, destroyPQExternalIterators);
+    int expected_outer = 9;
+    for(int* i = pqIterNext(outer); i; i = pqIterNext(outer)){
+        ASSERT_TEST(*i == expected_outer--, destroyPQExternalIterators);
+        inner = pqIterBegin(pq);
+        int count = 0;
+        for(int* j = pqIterNext(inner); j; j = pqIterNext(inner)){
+            count++;
+        }
+        pqIterEnd(inner);
+        inner = NULL;
+        ASSERT_TEST(count == 10, destroyPQExternalIterators);
+    }
+    ASSERT_TEST(expected_outer == -1, destroyPQExternalIterators);
+    ASSERT_TEST(*(int*)pqGetNext(pq) == 8, destroyPQExternalIterators);
+    pqIterEnd(outer);
+
+    outer = pqIterBegin(pq);
+    ASSERT_TEST(*(int*)pqIterNext(outer) == 9, destroyPQExternalIterators);
+    ASSERT_TEST(pqRemove(pq) == PQ_SUCCESS, destroyPQExternalIterators);
+    ASSERT_TEST(pqIterNext(outer) == NULL, destroyPQExternalIterators);
+
+destroyPQExternalIterators:
+    pqIterEnd(outer);
+    pqIterEnd(inner);
+    pqDestroy(pq);
+    return result;
+}
+
+typedef struct PopWhileContext_t {
+    int bound;
+    int sum;
+} PopWhileContext;
+
+static bool isAboveBound(PQElement element, PQElementPriority priority, void* context) {
+    return *(int*)priority > ((PopWhileContext*)context)->bound;
+}
+
+static void sumElements(PQElement element, PQElementPriority priority, void* context) {
+    ((PopWhileContext*)context)->sum += *(int*)element;
+}
+
+bool testPQPopWhile() {
+    bool result = true;
+    PriorityQueue pq = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    for(int i=0; i< 10; i++){
+        ASSERT_TEST(pqInsert(pq, &i, &i) == PQ_SUCCESS, destroyPQPopWhile);
+    }
+    PopWhileContext context = {6, 0};
+    ASSERT_TEST(pqPopWhile(pq, NULL, &context, NULL) == PQ_NULL_ARGUMENT, destroyPQPopWhile);
+    ASSERT_TEST(pqPopWhile(pq, isAboveBound, &context, NULL) == PQ_SUCCESS, destroyPQPopWhile);
+    ASSERT_TEST(pqGetSize(pq) == 7, destroyPQPopWhile);
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 6, destroyPQPopWhile);
+    context.bound = 2;
+    ASSERT_TEST(pqPopWhile(pq, isAboveBound, &context, sumElements) == PQ_SUCCESS, destroyPQPopWhile);
+    ASSERT_TEST(pqGetSize(pq) == 3 && context.sum == 18, destroyPQPopWhile);
+    context.bound = -1;
+    ASSERT_TEST(pqPopWhile(pq, isAboveBound, &context, NULL) == PQ_SUCCESS, destroyPQPopWhile);
+    ASSERT_TEST(pqGetSize(pq) == 0, destroyPQPopWhile);
+
+destroyPQPopWhile:
+    pqDestroy(pq);
+    return result;
+}
+
+bool testPQPeekK() {
+    bool result = true;
+    PQOptions options = {copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric,
+                         compareIntsGeneric};
+    PQBackendType backends[] = {PQ_BACKEND_BINARY_HEAP, PQ_BACKEND_DARY_HEAP, PQ_BACKEND_PAIRING_HEAP};
+    PQElement elements[30];
+    PQElementPriority priorities[30];
+    for(int b=0; b< 3; b++){
+        options.backend = backends[b];
+        PriorityQueue pq = pqCreateEx(&options);
+        ASSERT_TEST(pq != NULL, returnPQPeekK);
+        for(int i=0; i< 20; i++){
+            int priority = (i * 7) % 20;
+            ASSERT_TEST(pqInsert(pq, &i, &priority) == PQ_SUCCESS, destroyPQPeekK);
+        }
+        ASSERT_TEST(pqPeekK(pq, -1, elements, NULL) == -1, destroyPQPeekK);
+        ASSERT_TEST(pqPeekK(pq, 5, elements, priorities) == 5, destroyPQPeekK);
+        for(int i=0; i< 5; i++){
+            ASSERT_TEST(*(int*)priorities[i] == 19 - i, destroyPQPeekK);
+            ASSERT_TEST((*(int*)elements[i] * 7) % 20 == 19 - i, destroyPQPeekK);
+        }
+        ASSERT_TEST(pqPeekK(pq, 30, elements, NULL) == 20, destroyPQPeekK);
+        ASSERT_TEST(pqGetSize(pq) == 20 && *(int*)pqGetFirst(pq) == *(int*)elements[0], destroyPQPeekK);
+    destroyPQPeekK:
+        pqDestroy(pq);
+        if(!result){
+            break;
+        }
+    }
+
+returnPQPeekK:
+    return result;
+}
+
+typedef struct RangeContext_t {
+    int elements[30];
+    int count;
+} RangeContext;
+
+static void collectInRange(PQElement element, PQElementPriority priority, void* context) {
+    RangeContext* range = context;
+    range->elements[range->count++] = *(int*)element;
+}
+
+bool testPQForEachInRange() {
+    bool result = true;
+    PQOptions options = {copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric,
+                         compareIntsGeneric};
+    PQBackendType backends[] = {PQ_BACKEND_SKIP_LIST, PQ_BACKEND_BINARY_HEAP};
+    int lo = 5, hi = 12, above = 100;
+    for(int b=0; b< 2; b++){
+        options.backend = backends[b];
+        PriorityQueue pq = pqCreateEx(&options);
+        ASSERT_TEST(pq != NULL, returnPQForEachInRange);
+        for(int i=0; i< 20; i++){
+            int priority = (i * 7) % 20;
+            ASSERT_TEST(pqInsert(pq, &priority, &priority) == PQ_SUCCESS, destroyPQForEachInRange);
+        }
+        RangeContext range = {{0}, 0};
+        ASSERT_TEST(pqForEachInRange(pq, &lo, NULL, collectInRange, &range) == PQ_NULL_ARGUMENT,
+                    destroyPQForEachInRange);
+        ASSERT_TEST(pqForEachInRange(pq, &lo, &hi, collectInRange, &range) == PQ_SUCCESS, destroyPQForEachInRange);
+        ASSERT_TEST(range.count == 8, destroyPQForEachInRange);
+        for(int i=0; i< 8; i++){
+            ASSERT_TEST(range.elements[i] == 12 - i, destroyPQForEachInRange);
+        }
+        ASSERT_TEST(pqRemoveElement(pq, &hi) == PQ_SUCCESS, destroyPQForEachInRange);
+        ASSERT_TEST(pqChangePriority(pq, &lo, &lo, &above) == PQ_SUCCESS, destroyPQForEachInRange);
+        range.count = 0;
+        ASSERT_TEST(pqForEachInRange(pq, &hi, &lo, collectInRange, &range) == PQ_SUCCESS, destroyPQForEachInRange);
+        ASSERT_TEST(range.count == 6 && range.elements[0] == 11 && range.elements[5] == 6, destroyPQForEachInRange);
+        range.count = 0;
+        ASSERT_TEST(pqForEachInRange(pq, &above, &above, collectInRange, &range) == PQ_SUCCESS,
+                    destroyPQForEachInRange);
+        ASSERT_TEST(range.count == 1 && range.elements[0] == 5, destroyPQForEachInRange);
+        ASSERT_TEST(pqGetSize(pq) == 19 && *(int*)pqGetFirst(pq) == 5, destroyPQForEachInRange);
+    destroyPQForEachInRange:
+        pqDestroy(pq);
+        if(!result){
+            break;
+        }
+    }
+
+returnPQForEachInRange:
+    return result;
+}
+
+bool testPQSnapshots() {
+    bool result = true;
+    PQOptions options = {copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric,
+                         compareIntsGeneric};
+    PriorityQueue plain = pqCreateEx(&options);
+    ASSERT_TEST(plain != NULL, returnPQSnapshots);
+    ASSERT_TEST(pqSnapshot(plain) == NULL, destroyPlainPQSnapshots);
+    options.persistent = true;
+    options.copy_on_write = true;
+    ASSERT_TEST(pqCreateEx(&options) == NULL, destroyPlainPQSnapshots);
+    options.copy_on_write = false;
+    PriorityQueue pq = pqCreateEx(&options);
+    ASSERT_TEST(pq != NULL, destroyPlainPQSnapshots);
+    for(int i=0; i< 10; i++){
+        ASSERT_TEST(pqInsert(pq, &i, &i) == PQ_SUCCESS, destroyPQSnapshots);
+    }
+    PQSnapshot before = pqSnapshot(pq);
+    ASSERT_TEST(before != NULL && pqSnapshotGetSize(before) == 10, destroyPQSnapshots);
+    int removed = 4, changed = 7, new_priority = 20;
+    ASSERT_TEST(pqRemoveElement(pq, &removed) == PQ_SUCCESS, releasePQSnapshots);
+    ASSERT_TEST(pqChangePriority(pq, &changed, &changed, &new_priority) == PQ_SUCCESS, releasePQSnapshots);
+    PQElement extracted = NULL;
+    ASSERT_TEST(pqExtract(pq, &extracted, NULL) == PQ_SUCCESS && *(int*)extracted == 7, releasePQSnapshots);
+    freeIntGeneric(extracted);
+    PQSnapshot after = pqSnapshot(pq);
+    ASSERT_TEST(pqClear(pq) == PQ_SUCCESS && pqGetSize(pq) == 0, releaseAllPQSnapshots);
+    RangeContext range = {{0}, 0};
+    ASSERT_TEST(pqSnapshotForEach(before, collectInRange, &range) == PQ_SUCCESS, releaseAllPQSnapshots);
+    ASSERT_TEST(range.count == 10, releaseAllPQSnapshots);
+    for(int i=0; i< 10; i++){
+        ASSERT_TEST(range.elements[i] == 9 - i, releaseAllPQSnapshots);
+    }
+    range.count = 0;
+    ASSERT_TEST(pqSnapshotForEach(after, collectInRange, &range) == PQ_SUCCESS, releaseAllPQSnapshots);
+    ASSERT_TEST(pqSnapshotGetSize(after) == 8 && range.count == 8, releaseAllPQSnapshots);
+    ASSERT_TEST(range.elements[0] == 9 && range.elements[2] == 6 && range.elements[3] == 5, releaseAllPQSnapshots);
+    ASSERT_TEST(pqSetNodePool(pq, pqGetNodePool(plain)) == PQ_ERROR, releaseAllPQSnapshots);
+
+releaseAllPQSnapshots:
+    pqRelease(after);
+releasePQSnapshots:
+    pqRelease(before);
+destroyPQSnapshots:
+    pqDestroy(pq);
+destroyPlainPQSnapshots:
+    pqDestroy(plain);
+returnPQSnapshots:
+    return result;
+}
+
+bool testPQMemoryStats() {
+    bool result = true;
+    PQOptions options = {copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric,
+                         compareIntsGeneric};
+    options.size_element = sizeIntGeneric;
+    options.size_priority = sizeIntGeneric;
+    PriorityQueue pq = pqCreateEx(&options);
+    ASSERT_TEST(pq != NULL, returnPQMemoryStats);
+    PQMemoryStats stats;
+    ASSERT_TEST(pqGetMemoryStats(NULL, &stats) == PQ_NULL_ARGUMENT, destroyPQMemoryStats);
+    ASSERT_TEST(pqGetMemoryStats(pq, NULL) == PQ_NULL_ARGUMENT, destroyPQMemoryStats);
+    ASSERT_TEST(pqGetMemoryStats(pq, &stats) == PQ_SUCCESS, destroyPQMemoryStats);
+    ASSERT_TEST(stats.node_bytes == 0 && stats.element_bytes == 0 && stats.peak_bytes == 0, destroyPQMemoryStats);
+    ASSERT_TEST(stats.structure_bytes > 0 && stats.total_bytes >= stats.structure_bytes, destroyPQMemoryStats);
+    for(int i=0; i< 10; i++){
+        ASSERT_TEST(pqInsert(pq, &i, &i) == PQ_SUCCESS, destroyPQMemoryStats);
+    }
+    ASSERT_TEST(pqGetMemoryStats(pq, &stats) == PQ_SUCCESS, destroyPQMemoryStats);
+    ASSERT_TEST(stats.element_bytes == 10 * sizeof(int) && stats.priority_bytes == 10 * sizeof(int),
+                destroyPQMemoryStats);
+    size_t node_bytes = stats.node_bytes, peak_bytes = stats.peak_bytes;
+    ASSERT_TEST(node_bytes > 0 && peak_bytes == node_bytes + 20 * sizeof(int), destroyPQMemoryStats);
+    ASSERT_TEST(stats.total_bytes == node_bytes + 20 * sizeof(int) + stats.structure_bytes + stats.slack_bytes,
+                destroyPQMemoryStats);
+    PQElement extracted = NULL;
+    ASSERT_TEST(pqExtract(pq, &extracted, NULL) == PQ_SUCCESS, destroyPQMemoryStats);
+    freeIntGeneric(extracted);
+    int changed = 3, new_priority = 30;
+    ASSERT_TEST(pqChangePriority(pq, &changed, &changed, &new_priority) == PQ_SUCCESS, destroyPQMemoryStats);
+    ASSERT_TEST(pqGetMemoryStats(pq, &stats) == PQ_SUCCESS, destroyPQMemoryStats);
+    ASSERT_TEST(stats.element_bytes == 9 * sizeof(int) && stats.priority_bytes == 9 * sizeof(int),
+                destroyPQMemoryStats);
+    ASSERT_TEST(stats.node_bytes == node_bytes / 10 * 9 && stats.peak_bytes == peak_bytes, destroyPQMemoryStats);
+    ASSERT_TEST(pqClear(pq) == PQ_SUCCESS && pqGetMemoryStats(pq, &stats) == PQ_SUCCESS, destroyPQMemoryStats);
+    ASSERT_TEST(stats.node_bytes == 0 && stats.element_bytes == 0 && stats.priority_bytes == 0, destroyPQMemoryStats);
+    ASSERT_TEST(stats.peak_bytes == peak_bytes, destroyPQMemoryStats);
+
+destroyPQMemoryStats:
+    pqDestroy(pq);
+returnPQMemoryStats:
+    return result;
+}
+
+bool testPQOpStats() {
+    bool result = true;
+    PriorityQueue pq = pqCreate(copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric);
+    ASSERT_TEST(pq != NULL, returnPQOpStats);
+    PQOpStats stats;
+    ASSERT_TEST(pqGetOpStats(NULL, &stats) == PQ_NULL_ARGUMENT, destroyPQOpStats);
+    ASSERT_TEST(pqGetOpStats(pq, NULL) == PQ_NULL_ARGUMENT, destroyPQOpStats);
+    for(int i=0; i< 5; i++){
+        ASSERT_TEST(pqInsert(pq, &i, &i) == PQ_SUCCESS, destroyPQOpStats);
+    }
+    int first = 0, missing = 10;
+    ASSERT_TEST(pqRemoveElement(pq, &first) == PQ_SUCCESS, destroyPQOpStats);
+    ASSERT_TEST(pqRemoveElement(pq, &missing) == PQ_ELEMENT_DOES_NOT_EXISTS, destroyPQOpStats);
+    PriorityQueueResult stats_result = pqGetOpStats(pq, &stats);
+    ASSERT_TEST(stats_result == PQ_SUCCESS || stats_result == PQ_ERROR, destroyPQOpStats);
+    if(stats_result == PQ_SUCCESS){
+        ASSERT_TEST(stats.inserts == 5 && stats.node_allocations == 5, destroyPQOpStats);
+        ASSERT_TEST(stats.element_copies == 5 && stats.priority_copies == 5, destroyPQOpStats);
+        ASSERT_TEST(stats.compare_calls == stats.key_comparisons, destroyPQOpStats);
+        ASSERT_TEST(stats.insert_scanned > 0 && stats.insert_scanned <= stats.key_comparisons, destroyPQOpStats);
+        ASSERT_TEST(stats.removes == 2 && stats.remove_scanned == stats.equal_calls, destroyPQOpStats);
+        ASSERT_TEST(stats.remove_scanned == 5 + 4, destroyPQOpStats);
+        PriorityQueue copy = pqCopy(pq);
+        ASSERT_TEST(copy != NULL, destroyPQOpStats);
+        ASSERT_TEST(pqGetOpStats(copy, &stats) == PQ_SUCCESS && stats.inserts == 0, destroyCopyPQOpStats);
+    destroyCopyPQOpStats:
+        pqDestroy(copy);
+    }
+
+destroyPQOpStats:
+    pqDestroy(pq);
+returnPQOpStats:
+    return result;
+}
+
+bool testTypedPQ() {
+    bool result = true;
+    IntPQ pq = IntPQCreate();
+    ASSERT_TEST(pq != NULL, returnTypedPQ);
+    ASSERT_TEST(IntPQGetSize(pq) == 0 && IntPQGetFirst(pq) == NULL, destroyTypedPQ);
+    int priorities[] = {5, 3, 9, 3};
+    for(int i=0; i< 4; i++){
+        ASSERT_TEST(IntPQInsert(pq, i, priorities[i]) == PQ_SUCCESS, destroyTypedPQ);
+    }
+    int expected[] = {2, 0, 1, 3};
+    int i = 0;
+    TYPED_PQ_FOREACH(IntPQ, iter, pq) {
+        ASSERT_TEST(i < 4 && *iter == expected[i], destroyTypedPQ);
+        i++;
+    }
+    ASSERT_TEST(i == 4, destroyTypedPQ);
+    int element = -1, priority = -1;
+    ASSERT_TEST(IntPQExtract(pq, &element, &priority) == PQ_SUCCESS, destroyTypedPQ);
+    ASSERT_TEST(element == 2 && priority == 9 && IntPQGetSize(pq) == 3, destroyTypedPQ);
+    ASSERT_TEST(IntPQClear(pq) == PQ_SUCCESS && IntPQGetFirst(pq) == NULL, destroyTypedPQ);
+    ASSERT_TEST(IntPQExtract(pq, &element, NULL) == PQ_ELEMENT_DOES_NOT_EXISTS, destroyTypedPQ);
+    for(int j=0; j< 100; j++){
+        ASSERT_TEST(IntPQInsert(pq, j, (j * 37) % 100) == PQ_SUCCESS, destroyTypedPQ);
+    }
+    for(int j=99; j>= 0; j--){
+        ASSERT_TEST(IntPQExtract(pq, &element, &priority) == PQ_SUCCESS && priority == j, destroyTypedPQ);
+        ASSERT_TEST((element * 37) % 100 == j, destroyTypedPQ);
+    }
+
+destroyTypedPQ:
+    IntPQDestroy(pq);
+returnTypedPQ:
+    return result;
+}
+
+bool testPQKeyArray() {
+    bool result = true;
+    PQOptions options = {copyIntGeneric, freeIntGeneric, equalIntsGeneric};
+    options.key_type = PQ_KEY_INT64;
+    options.lowest_first = true;
+    options.backend = PQ_BACKEND_SORTED_ARRAY;
+    PriorityQueue pq = pqCreateEx(&options);
+    ASSERT_TEST(pq != NULL, returnPQKeyArray);
+    for(int i=0; i< 40; i++){
+        int64_t key = i % 10;
+        ASSERT_TEST(pqInsert(pq, &i, &key) == PQ_SUCCESS, destroyPQKeyArray);
+    }
+    int position = 0;
+    PQ_FOREACH(int*, iter, pq) {
+        ASSERT_TEST(*iter == (position % 4) * 10 + position / 4, destroyPQKeyArray);
+        position++;
+    }
+    ASSERT_TEST(position == 40, destroyPQKeyArray);
+    int changed = 5;
+    int64_t old_key = 5, new_key = -1, lo = 3, hi = 2;
+    ASSERT_TEST(pqChangePriority(pq, &changed, &old_key, &new_key) == PQ_SUCCESS, destroyPQKeyArray);
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 5, destroyPQKeyArray);
+    RangeContext range = {{0}, 0};
+    ASSERT_TEST(pqForEachInRange(pq, &lo, &hi, collectInRange, &range) == PQ_SUCCESS, destroyPQKeyArray);
+    int expected[] = {2, 12, 22, 32, 3, 13, 23, 33};
+    ASSERT_TEST(range.count == 8, destroyPQKeyArray);
+    for(int i=0; i< 8; i++){
+        ASSERT_TEST(range.elements[i] == expected[i], destroyPQKeyArray);
+    }
+    int removed = 0;
+    ASSERT_TEST(pqRemoveElement(pq, &removed) == PQ_SUCCESS, destroyPQKeyArray);
+    PQElement extracted = NULL;
+    ASSERT_TEST(pqExtract(pq, &extracted, NULL) == PQ_SUCCESS && *(int*)extracted == 5, destroyPQKeyArray);
+    freeIntGeneric(extracted);
+    ASSERT_TEST(pqExtract(pq, &extracted, NULL) == PQ_SUCCESS && *(int*)extracted == 10, destroyPQKeyArray);
+    freeIntGeneric(extracted);
+
+destroyPQKeyArray:
+    pqDestroy(pq);
+returnPQKeyArray:
+    return result;
+}
+
+bool testPQLazyRemoval() {
+    bool result = true;
+    PQOptions options = {copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric};
+    options.lazy_removal = true;
+    options.persistent = true;
+    ASSERT_TEST(pqCreateEx(&options) == NULL, returnPQLazyRemoval);
+    options.persistent = false;
+    options.tombstone_ratio = -1;
+    ASSERT_TEST(pqCreateEx(&options) == NULL, returnPQLazyRemoval);
+    options.tombstone_ratio = 1;
+    PriorityQueue pq = pqCreateEx(&options);
+    ASSERT_TEST(pq != NULL, returnPQLazyRemoval);
+    PQHandle handles[10];
+    for(int i=0; i< 10; i++){
+        ASSERT_TEST(pqInsertWithHandle(pq, &i, &i, &handles[i]) == PQ_SUCCESS, destroyPQLazyRemoval);
+    }
+    PQMemoryStats before, after;
+    ASSERT_TEST(pqGetMemoryStats(pq, &before) == PQ_SUCCESS, destroyPQLazyRemoval);
+    for(int i=1; i< 7; i++){
+        ASSERT_TEST(pqRemoveByHandle(pq, handles[i]) == PQ_SUCCESS, destroyPQLazyRemoval);
+    }
+    ASSERT_TEST(pqRemoveByHandle(pq, handles[4]) == PQ_ELEMENT_DOES_NOT_EXISTS, destroyPQLazyRemoval);
+    int removed = 5;
+    ASSERT_TEST(pqContains(pq, &removed) == false, destroyPQLazyRemoval);
+    ASSERT_TEST(pqRemoveElement(pq, &removed) == PQ_ELEMENT_DOES_NOT_EXISTS, destroyPQLazyRemoval);
+    ASSERT_TEST(pqGetSize(pq) == 4, destroyPQLazyRemoval);
+    int expected[] = {9, 8, 7, 0};
+    int i = 0;
+    PQ_FOREACH(int*, iter, pq) {
+        ASSERT_TEST(i < 4 && *iter == expected[i], destroyPQLazyRemoval);
+        i++;
+    }
+    ASSERT_TEST(i == 4, destroyPQLazyRemoval);
+    ASSERT_TEST(pqRemove(pq) == PQ_SUCCESS && pqRemove(pq) == PQ_SUCCESS, destroyPQLazyRemoval);
+    ASSERT_TEST(*(int*)pqGetFirst(pq) == 7 && pqGetSize(pq) == 2, destroyPQLazyRemoval);
+    ASSERT_TEST(pqGetMemoryStats(pq, &after) == PQ_SUCCESS, destroyPQLazyRemoval);
+    ASSERT_TEST(after.node_bytes == before.node_bytes / 10 * 8, destroyPQLazyRemoval);
+    ASSERT_TEST(pqCompact(NULL) == PQ_NULL_ARGUMENT, destroyPQLazyRemoval);
+    ASSERT_TEST(pqCompact(pq) == PQ_SUCCESS && pqGetSize(pq) == 2, destroyPQLazyRemoval);
+    ASSERT_TEST(pqGetMemoryStats(pq, &after) == PQ_SUCCESS, destroyPQLazyRemoval);
+    ASSERT_TEST(after.node_bytes == before.node_bytes / 5, destroyPQLazyRemoval);
+    int first = 7;
+    ASSERT_TEST(pqRemoveElement(pq, &first) == PQ_SUCCESS && *(int*)pqGetFirst(pq) == 0, destroyPQLazyRemoval);
+
+destroyPQLazyRemoval:
+    pqDestroy(pq);
+returnPQLazyRemoval:
+    return result;
+}
+
+bool testPQInsertBatch() {
+    bool result = true;
+    PQOptions options = {copyIntGeneric, freeIntGeneric, equalIntsGeneric, copyIntGeneric, freeIntGeneric, compareIntsGeneric};
+    PQBackendType backends[] = {PQ_BACKEND_BINARY_HEAP, PQ_BACKEND_PAIRING_HEAP, PQ_BACKEND_SORTED_ARRAY,
+                                PQ_BACKEND_SKIP_LIST};
+    for(int b=0; b< 4; b++){
+        options.backend = backends[b];
+        PriorityQueue pq = pqCreateEx(&options);
+        ASSERT_TEST(pq != NULL, returnPQInsertBatch);
+        ASSERT_TEST(pqInsertBatch(NULL, NULL, NULL, 0, NULL) == PQ_NULL_ARGUMENT, destroyPQInsertBatch);
+        ASSERT_TEST(pqInsertBatch(pq, NULL, NULL, 1, NULL) == PQ_NULL_ARGUMENT, destroyPQInsertBatch);
+        ASSERT_TEST(pqInsertBatch(pq, NULL, NULL, 0, NULL) == PQ_SUCCESS, destroyPQInsertBatch);
+        for(int i=0; i< 3; i++){
+            int priority = 2 * i;
+            ASSERT_TEST(pqInsert(pq, &i, &priority) == PQ_SUCCESS, destroyPQInsertBatch);
+        }
+        int values[] = {3, 4, 5, 6, 7};
+        int priorities[] = {2, 5, 0, 1, 9};
+        PQElement elements[] = {&values[0], &values[1], NULL, &values[3], &values[4]};
+        PQElementPriority batch_priorities[] = {&priorities[0], &priorities[1], &priorities[2], &priorities[3],
+                                                &priorities[4]};
+        PriorityQueueResult results[5];
+        ASSERT_TEST(pqInsertBatch(pq, elements, batch_priorities, 5, results) == PQ_NULL_ARGUMENT, destroyPQInsertBatch);
+        ASSERT_TEST(results[2] == PQ_NULL_ARGUMENT, destroyPQInsertBatch);
+        ASSERT_TEST(results[0] == PQ_SUCCESS && results[4] == PQ_SUCCESS, destroyPQInsertBatch);
+        ASSERT_TEST(pqGetSize(pq) == 7, destroyPQInsertBatch);
+        int expected[] = {7, 4, 2, 1, 3, 6, 0};
+        int i = 0;
+        PQ_FOREACH(int*, iter, pq) {
+            ASSERT_TEST(i < 7 && *iter == expected[i], destroyPQInsertBatch);
+            i++;
+        }
+        ASSERT_TEST(i == 7, destroyPQInsertBatch);
+        PQElement extracted = NULL;
+        ASSERT_TEST(pqExtract(pq, &extracted, NULL) == PQ_SUCCESS && *(int*)extracted == 7, destroyPQInsertBatch);
+        freeIntGeneric(extracted);
+
+    destroyPQInsertBatch:
+        pqDestroy(pq);
+        if(!result){
+            break;
+        }
+    }
+
+returnPQInsertBatch:
+    return result;
+}
+
 bool (*tests[]) (void) = {
         testPQCreateDestroy,
         testPQInsertAndSize,
         testPQGetFirst,
-        testPQIterator
+        testPQIterator,
+        testPQOrder,
+        testPQIteratorInvalidation,
+        testPQHandles,
+        testPQHashIndex,
+        testPQNodePool,
+        testPQOwnership,
+        testPQCreateFromArray,
+        testPQMerge,
+        testPQCopyOnWrite,
+        testPQInlineKeys,
+        testPQCalendar,
+        testPQBackends,
+        testPQConcurrent,
+        testPQCompareFirst,
+        testPQExternalIterators,
+        testPQPopWhile,
+        testPQPeekK,
+        testPQForEachInRange,
+        testPQSnapshots,
+        testPQMemoryStats,
+        testPQOpStats,
+        testTypedPQ,
+        testPQKeyArray,
+        testPQLazyRemoval,
+        testPQInsertBatch
 };
 
 const char* testNames[] = {
         "testPQCreateDestroy",
         "testPQInsertAndSize",
         "testPQGetFirst",
-        "testPQIterator"
+        "testPQIterator",
+        "testPQOrder",
+        "testPQIteratorInvalidation",
+        "testPQHandles",
+        "testPQHashIndex",
+        "testPQNodePool",
+        "testPQOwnership",
+        "testPQCreateFromArray",
+        "testPQMerge",
+        "testPQCopyOnWrite",
+        "testPQInlineKeys",
+        "testPQCalendar",
+        "testPQBackends",
+        "testPQConcurrent",
+        "testPQCompareFirst",
+        "testPQExternalIterators",
+        "testPQPopWhile",
+        "testPQPeekK",
+        "testPQForEachInRange",
+        "testPQSnapshots",
+        "testPQMemoryStats",
+        "testPQOpStats",
+        "testTypedPQ",
+        "testPQKeyArray",
+        "testPQLazyRemoval",
+        "testPQInsertBatch"
 };
 
 int main(int argc, char *argv[]) {
@@ -0,0 +1,247 @@
+#ifndef TYPED_PRIORITY_QUEUE_H_
+#define TYPED_PRIORITY_QUEUE_H_
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "priority_queue.h"
+
+/**
+* Type-Specialized Priority Queue Generator
+*
+* DEFINE_TYPED_PQ(Name, ElementType, PriorityType, compare) defines a priority queue type Name, which holds
+* elements of type ElementType with priorities of type PriorityType by value, and compares the priorities by
+* calling compare(PriorityType, PriorityType) directly. compare returns a positive integer if the first
+* priority is higher, 0 if they are equal and a negative integer otherwise, like ComparePQElementPriorities.
+* Unlike the generic priority queue, no call goes through a function pointer, so the compiler can inline
+* compare and keep small elements and priorities in registers. Elements with equal priorities come out in the order
+* they were inserted.
+* The queue is a binary heap. Elements are copied in and out by assignment, and the queue never frees
+* what they point to, so elements which own memory are released by the caller after they are extracted.
+* The macro should be used once per type, in a source file or in a header included by several source files,
+* since all the functions it defines are static inline.
+*
+* The following functions are defined, mirroring the generic priority queue:
+*   NameCreate          - Creates a new empty priority queue
+*   NameDestroy         - Deletes an existing priority queue
+*   NameGetSize         - Returns the number of elements in a priority queue
+*   NameInsert          - Inserts an element with a given priority
+*   NameExtract         - Removes the highest priority element and returns it with its priority
+*   NameGetFirst        - Sets the internal iterator to the first element and returns a pointer to it
+*   NameGetNext         - Advances the internal iterator and returns a pointer to the next element
+*   NameClear           - Removes all the elements of a priority queue
+*   TYPED_PQ_FOREACH    - A macro for iterating over the elements in order, like PQ_FOREACH.
+* Iteration goes over a sorted copy of the elements, which is made when the queue is iterated after a change,
+* so the pointers returned by NameGetFirst and NameGetNext stay valid until the queue is changed.
+*/
+
+/** Constants for the typed priority queue - the initial capacity, and the factor by which it grows */
+#define TYPED_PQ_INITIAL_CAPACITY 16
+#define TYPED_PQ_EXPAND_FACTOR 2
+
+/*!
+* Macro for iterating over a typed priority queue of type Name, in order.
+* Declares a new iterator for the loop, which points to the current element.
+*/
+#define TYPED_PQ_FOREACH(Name, iterator, queue) \
+    for(Name##Element* iterator = Name##GetFirst(queue) ; \
+        iterator ; \
+        iterator = Name##GetNext(queue))
+
+/*!
+* Macro defining a typed priority queue, see above.
+* Name##Entry is an element with its priority, and the order in which it was inserted.
+* Name##IsBefore - true if entry1 comes out of the queue before entry2.
+* Name##SiftDown - Moves the entry at index down the heap of the first size entries.
+*/
+#define DEFINE_TYPED_PQ(Name, ElementType, PriorityType, compare) \
+    typedef ElementType Name##Element; \
+    typedef PriorityType Name##Priority; \
+    \
+    typedef struct Name##Entry_t { \
+        ElementType element; \
+        PriorityType priority; \
+        unsigned long order; \
+    } Name##Entry; \
+    \
+    typedef struct Name##_t { \
+        Name##Entry* entries; \
+        int size; \
+        int capacity; \
+        unsigned long next_order; \
+        Name##Entry* sorted; \
+        bool sorted_valid; \
+        int iterator; \
+    } *Name; \
+    \
+    static inline bool Name##IsBefore(const Name##Entry* entry1, const Name##Entry* entry2) \
+    { \
+        int result = compare(entry1->priority, entry2->priority); \
+        return result > 0 || (result == 0 && entry1->order < entry2->order); \
+    } \
+    \
+    static inline void Name##SiftDown(Name##Entry* entries, int size, int index) \
+    { \
+        Name##Entry entry = entries[index]; \
+        for(int child = 2 * index + 1; child < size; child = 2 * index + 1) \
+        { \
+            if(child + 1 < size && Name##IsBefore(&entries[child + 1], &entries[child])) \
+            { \
+                child++; \
+            } \
+            if(!Name##IsBefore(&entries[child], &entry)) \
+            { \
+                break; \
+            } \
+            entries[index] = entries[child]; \
+            index = child; \
+        } \
+        entries[index] = entry; \
+    } \
+    \
+    static inline void Name##Changed(Name queue) \
+    { \
+        queue->sorted_valid = false; \
+        queue->iterator = -1; \
+    } \
+    \
+    static inline Name Name##Create(void) \
+    { \
+        Name queue = malloc(sizeof(*queue)); \
+        if(!queue) \
+        { \
+            return NULL; \
+        } \
+        queue->entries = malloc(TYPED_PQ_INITIAL_CAPACITY * sizeof(*queue->entries)); \
+        if(!queue->entries) \
+        { \
+            free(queue); \
+            return NULL; \
+        } \
+        queue->size = 0; \
+        queue->capacity = TYPED_PQ_INITIAL_CAPACITY; \
+        queue->next_order = 0; \
+        queue->sorted = NULL; \
+        Name##Changed(queue); \
+        return queue; \
+    } \
+    \
+    static inline void Name##Destroy(Name queue) \
+    { \
+        if(!queue) \
+        { \
+            return; \
+        } \
+        free(queue->entries); \
+        free(queue->sorted); \
+        free(queue); \
+    } \
+    \
+    static inline int Name##GetSize(Name queue) \
+    { \
+        return queue ? queue->size : -1; \
+    } \
+    \
+    static inline PriorityQueueResult Name##Insert(Name queue, ElementType element, PriorityType priority) \
+    { \
+        if(!queue) \
+        { \
+            return PQ_NULL_ARGUMENT; \
+        } \
+        if(queue->size == queue->capacity) \
+        { \
+            int capacity = queue->capacity * TYPED_PQ_EXPAND_FACTOR; \
+            Name##Entry* entries = realloc(queue->entries, capacity * sizeof(*entries)); \
+            if(!entries) \
+            { \
+                return PQ_OUT_OF_MEMORY; \
+            } \
+            queue->entries = entries; \
+            queue->capacity = capacity; \
+        } \
+        Name##Changed(queue); \
+        Name##Entry entry = {element, priority, queue->next_order++}; \
+        int index = queue->size++; \
+        while(index > 0 && Name##IsBefore(&entry, &queue->entries[(index - 1) / 2])) \
+        { \
+            queue->entries[index] = queue->entries[(index - 1) / 2]; \
+            index = (index - 1) / 2; \
+        } \
+        queue->entries[index] = entry; \
+        return PQ_SUCCESS; \
+    } \
+    \
+    static inline PriorityQueueResult Name##Extract(Name queue, ElementType* element, PriorityType* priority) \
+    { \
+        if(!queue || !element) \
+        { \
+            return PQ_NULL_ARGUMENT; \
+        } \
+        if(queue->size == 0) \
+        { \
+            return PQ_ELEMENT_DOES_NOT_EXISTS; \
+        } \
+        Name##Changed(queue); \
+        *element = queue->entries[0].element; \
+        if(priority) \
+        { \
+            *priority = queue->entries[0].priority; \
+        } \
+        queue->entries[0] = queue->entries[--queue->size]; \
+        Name##SiftDown(queue->entries, queue->size, 0); \
+        return PQ_SUCCESS; \
+    } \
+    \
+    static inline ElementType* Name##GetFirst(Name queue) \
+    { \
+        if(!queue || queue->size == 0) \
+        { \
+            return NULL; \
+        } \
+        if(!queue->sorted_valid) \
+        { \
+            Name##Entry* sorted = realloc(queue->sorted, queue->capacity * sizeof(*sorted)); \
+            if(!sorted) \
+            { \
+                return NULL; \
+            } \
+            memcpy(sorted, queue->entries, queue->size * sizeof(*sorted)); \
+            for(int end = queue->size - 1; end > 0; end--) \
+            { \
+                Name##Entry first = sorted[0]; \
+                sorted[0] = sorted[end]; \
+                sorted[end] = first; \
+                Name##SiftDown(sorted, end, 0); \
+            } \
+            queue->sorted = sorted; \
+            queue->sorted_valid = true; \
+        } \
+        queue->iterator = queue->size - 1; \
+        return &queue->sorted[queue->iterator].element; \
+    } \
+    \
+    static inline ElementType* Name##GetNext(Name queue) \
+    { \
+        if(!queue || queue->iterator <= 0) \
+        { \
+            if(queue) \
+            { \
+                queue->iterator = -1; \
+            } \
+            return NULL; \
+        } \
+        return &queue->sorted[--queue->iterator].element; \
+    } \
+    \
+    static inline PriorityQueueResult Name##Clear(Name queue) \
+    { \
+        if(!queue) \
+        { \
+            return PQ_NULL_ARGUMENT; \
+        } \
+        Name##Changed(queue); \
+        queue->size = 0; \
+        return PQ_SUCCESS; \
+    }
+
+#endif /* TYPED_PRIORITY_QUEUE_H_ */